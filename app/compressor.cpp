@@ -0,0 +1,441 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "block_type_0.hpp"
+#include "block_type_1.hpp"
+#include "block_type_2.hpp"
+#include "compressor.hpp"
+#include "crc32.hpp"
+#include "tokenizers.hpp"
+
+namespace {
+
+// The number of bytes in each chunk of the input that the cost-based block
+// splitter splits into blocks.
+constexpr std::size_t block_splitter_chunk_size = 1U << 20U;
+
+// The number of bytes put into a block between checks of the memory used to
+// buffer it. A block stream buffers at most a few bytes per byte put, so the
+// memory of a block overshoots its maximum by at most a few times this.
+constexpr std::size_t block_memory_check_interval = 1U << 12U;
+
+// Block type 1 is only suitable for small blocks, where the overhead of block
+// type 2 is comparatively large. Blocks cut at change points are at least the
+// warmup of the detector, larger than the maximum desirable size of a block of
+// type 1, and block type 2 encodes its own short blocks with the fixed codes
+// where that is smaller, so disable block type 1 entirely by setting its
+// breakpoint to 0. This improves speed by reducing the number of LZSS
+// searches, and saves the memory of its stream, which is only made for a
+// nonzero breakpoint.
+constexpr std::size_t maximum_uncompressed_bytes_in_block_type_1 = 0;
+
+// A sample of the input looks incompressible when its entropy is at least this
+// many bits per byte, so that prefix codes alone would save at most about 1%,
+// and when at most incompressible_match_rate of the bytes tokenized since the
+// previous sample were covered by back references. The entropy of samples of
+// already compressed files (e.g. pear.jpg, pg1513.epub) is about 7.93, and of
+// uncompressed files at most 6.4.
+constexpr double incompressible_entropy = 7.9;
+constexpr double incompressible_match_rate = 1.0 / 32;
+
+// The units of the target throughput and of the deadline in the options.
+constexpr double bytes_per_megabyte = 1e6;
+constexpr double milliseconds_per_second = 1e3;
+
+} // namespace
+
+static_assert(
+    sizeof(Compressor) + sizeof(block_type_0::Stream<>) +
+        sizeof(block_type_2::Stream<supported_windows.back()>) <=
+    maximum_fixed_context_size);
+
+Compressor::Compressor(std::ostream &out, const Options &options)
+    : out_{out}, options_{options},
+      is_byte_change_point_detection_{
+          options.block_splitter == BlockSplitter::cusum &&
+          options.change_point_symbols == ChangePointSymbols::bytes},
+      is_symbol_change_point_detection_{
+          options.block_splitter == BlockSplitter::cusum &&
+          options.change_point_symbols == ChangePointSymbols::tokens},
+      stream_{out},
+      byte_change_point_detector_{options.change_point_detector_params},
+      symbol_change_point_detector_{options.change_point_detector_params},
+      is_incompressible_region_detection_{options.incompressible_regions ==
+                                          IncompressibleRegions::store},
+      is_effort_control_{options.target_mbps.has_value() ||
+                         options.deadline_ms.has_value()},
+      block_streams_{make_block_streams()} {
+  maximum_of_maximum_uncompressed_block_sizes_ =
+      std::ranges::max_element(block_streams_,
+                               [](const auto &a, const auto &b) {
+                                 return a.maximum_uncompressed_bytes_in_block <
+                                        b.maximum_uncompressed_bytes_in_block;
+                               })
+          ->maximum_uncompressed_bytes_in_block;
+  has_literal_block_stream_ =
+      std::ranges::any_of(block_streams_, [](const auto &block_stream) {
+        return block_stream.coding == Coding::literals;
+      });
+  if (options.target_mbps) {
+    effort_controller_.emplace(static_cast<double>(*options.target_mbps) *
+                               bytes_per_megabyte);
+    effort_interval_start_ = std::clock();
+  }
+  stream_.push_header();
+}
+
+auto Compressor::make_block_streams()
+    -> std::vector<BlockStreamWithMaximumBlockSize> {
+  switch (options_.strategy) {
+  case Strategy::huffman_only:
+    return make_block_streams<maximum_look_back_size, LiteralTokenizer>();
+  case Strategy::rle:
+    return make_block_streams<
+        maximum_look_back_size,
+        RunLengthTokenizer<maximum_look_ahead_size>>();
+  case Strategy::lzss:
+    break;
+  }
+  static_assert(supported_windows.size() == 4);
+  switch (options_.window) {
+  case supported_windows[0]:
+    return make_block_streams<supported_windows[0]>();
+  case supported_windows[1]:
+    return make_block_streams<supported_windows[1]>();
+  case supported_windows[2]:
+    return make_block_streams<supported_windows[2]>();
+  case supported_windows[3]:
+    return make_block_streams<supported_windows[3]>();
+  default:
+    throw std::invalid_argument("Unsupported window: " +
+                                std::to_string(options_.window));
+  }
+}
+
+template <std::uint16_t LookBackSize, typename Tokenizer>
+auto Compressor::make_block_streams()
+    -> std::vector<BlockStreamWithMaximumBlockSize> {
+  const auto is_cost_splitting =
+      options_.block_splitter == BlockSplitter::cost;
+  auto block_type_2_stream = std::make_unique<
+      block_type_2::Stream<LookBackSize, maximum_look_ahead_size, Tokenizer>>(
+      stream_, is_cost_splitting, options_.reparse_passes);
+  match_finder_counters_ = [stream = block_type_2_stream.get()] {
+    return stream->match_finder_counters();
+  };
+  token_counters_ = [stream = block_type_2_stream.get()] {
+    return stream->token_counters();
+  };
+  block_type_2_stream->set_match_finder_effort(options_.chain_visits,
+                                               maximum_look_ahead_size);
+  set_effort_ = [this,
+                 stream = block_type_2_stream.get()](const Effort &effort) {
+    stream->set_match_finder_effort(
+        std::min<std::size_t>(effort.maximum_chain_visits,
+                              options_.chain_visits),
+        effort.maximum_indexed_length);
+  };
+  if (is_symbol_change_point_detection_) {
+    block_type_2_stream->set_symbol_listener([this](std::uint16_t symbol) {
+      if (is_symbol_change_point_detection_ &&
+          symbol_change_point_detector_.step(symbol)) {
+        is_symbol_change_point_detected_ = true;
+      }
+    });
+  }
+
+  std::vector<BlockStreamWithMaximumBlockSize> block_streams;
+  block_streams.push_back(BlockStreamWithMaximumBlockSize{
+      .block_stream = std::make_unique<
+          block_type_0::Stream<block_type_0::maximum_capacity>>(stream_),
+      .maximum_uncompressed_bytes_in_block = block_type_0::maximum_capacity,
+      .coding = Coding::stored});
+  if (maximum_uncompressed_bytes_in_block_type_1 > 0) {
+    block_streams.push_back(BlockStreamWithMaximumBlockSize{
+        .block_stream = std::make_unique<
+            block_type_1::Stream<LookBackSize, maximum_look_ahead_size>>(
+            stream_),
+        .maximum_uncompressed_bytes_in_block =
+            maximum_uncompressed_bytes_in_block_type_1});
+  }
+  block_streams.push_back(BlockStreamWithMaximumBlockSize{
+      .block_stream = std::move(block_type_2_stream),
+      .maximum_uncompressed_bytes_in_block =
+          is_cost_splitting ? block_splitter_chunk_size : 1U << 30U});
+  if (is_effort_control_ && !std::is_same_v<Tokenizer, LiteralTokenizer>) {
+    block_streams.push_back(BlockStreamWithMaximumBlockSize{
+        .block_stream = std::make_unique<
+            block_type_2::Stream<maximum_look_back_size,
+                                 maximum_look_ahead_size, LiteralTokenizer>>(
+            stream_, is_cost_splitting, options_.reparse_passes),
+        .maximum_uncompressed_bytes_in_block =
+            is_cost_splitting ? block_splitter_chunk_size : 1U << 30U,
+        .coding = Coding::literals});
+  }
+  return block_streams;
+}
+
+auto Compressor::put(std::uint8_t byte) -> void {
+  if (num_uncompressed_bytes_in_file_ > 0) {
+    cut_block_if_needed();
+  }
+  crc_ = crc32(crc_, std::span(&byte, 1));
+  num_uncompressed_bytes_in_file_++;
+  num_unflushed_bytes_++;
+  if (effort_controller_ &&
+      num_uncompressed_bytes_in_file_ % effort_interval == 0) {
+    adjust_effort();
+  }
+
+  if (undecided_bytes_.is_full()) {
+    put_into_block(undecided_bytes_.dequeue());
+  }
+  undecided_bytes_.enqueue(byte);
+  is_byte_change_point_detected_ = is_byte_change_point_detection_ &&
+                                   step_byte_change_point_detector(byte);
+  if (is_incompressible_region_detection_ && entropy_sampler_.step(byte)) {
+    is_incompressible_region_ = is_incompressible_sample();
+  }
+}
+
+auto Compressor::compress(std::span<const std::uint8_t> bytes) -> void {
+  if (num_uncompressed_bytes_in_file_ == 0) {
+    set_input_size(bytes.size());
+  }
+  for (const auto byte : bytes) {
+    put(byte);
+  }
+  finish();
+}
+
+auto Compressor::flush(Flush flush) -> void {
+  if (num_uncompressed_bytes_in_block_ > 0 || !undecided_bytes_.is_empty()) {
+    cut_block(0);
+  }
+  is_byte_change_point_detected_ = false;
+  if (flush == Flush::full) {
+    for (const auto &block_stream_with_maximum_block_size : block_streams_) {
+      block_stream_with_maximum_block_size.block_stream->clear_history();
+    }
+  }
+  // The block stream of type 0 has just been reset, so committing it writes
+  // an empty block of type 0, which ends on a byte boundary.
+  block_streams_.front().block_stream->commit(false);
+  // The stream may now be idle for some time (e.g. waiting on a client), so
+  // the memory of its blocks is freed rather than kept for the next block.
+  for (const auto &block_stream_with_maximum_block_size : block_streams_) {
+    block_stream_with_maximum_block_size.block_stream->release_memory();
+  }
+  out_.flush();
+  num_unflushed_bytes_ = 0;
+}
+
+auto Compressor::finish() -> void {
+  if (num_uncompressed_bytes_in_file_ > 0) {
+    while (!undecided_bytes_.is_empty()) {
+      put_into_block(undecided_bytes_.dequeue());
+    }
+    commit_smallest(true);
+
+    // Pad to byte boundary before returning from deflate bitstream to gz
+    // bitstream
+    stream_.flush_byte();
+  }
+
+  stream_.push_footer(crc_, num_uncompressed_bytes_in_file_);
+}
+
+auto Compressor::set_input_size(std::size_t size) -> void {
+  // A block tokenizes to at most one symbol per byte, so neither detector
+  // would finish its warmup.
+  if (size < static_cast<std::size_t>(
+                 options_.change_point_detector_params.warmup)) {
+    is_byte_change_point_detection_ = false;
+    is_symbol_change_point_detection_ = false;
+  }
+  if (!options_.deadline_ms || size == 0) {
+    return;
+  }
+  const auto target_bytes_per_second =
+      static_cast<double>(size) * milliseconds_per_second /
+      static_cast<double>(*options_.deadline_ms);
+  // Both a target throughput and a deadline are met by the faster of them.
+  if (effort_controller_) {
+    effort_controller_->set_target_bytes_per_second(
+        std::max(effort_controller_->target_bytes_per_second(),
+                 target_bytes_per_second));
+  } else {
+    effort_controller_.emplace(target_bytes_per_second);
+    effort_interval_start_ = std::clock();
+  }
+}
+
+auto Compressor::is_candidate(
+    const BlockStreamWithMaximumBlockSize &block_stream_with_maximum_block_size)
+    const -> bool {
+  return block_stream_with_maximum_block_size.coding == Coding::stored ||
+         block_stream_with_maximum_block_size.coding == coding_;
+}
+
+auto Compressor::is_incompressible_sample() -> bool {
+  if (entropy_sampler_.entropy() < incompressible_entropy) {
+    return false;
+  }
+  if (coding_ != Coding::back_references) {
+    return true;
+  }
+  const auto token_counters = token_counters_();
+  const auto num_bytes =
+      token_counters.num_bytes - sampled_token_counters_.num_bytes;
+  const auto num_literals =
+      token_counters.num_literals - sampled_token_counters_.num_literals;
+  sampled_token_counters_ = token_counters;
+  return static_cast<double>(num_bytes - num_literals) <=
+         incompressible_match_rate * static_cast<double>(num_bytes);
+}
+
+auto Compressor::coding() const -> Coding {
+  if (is_incompressible_region_) {
+    return Coding::stored;
+  }
+  if (!effort_controller_) {
+    return Coding::back_references;
+  }
+  const auto coding = effort_controller_->effort().coding;
+  if (coding == Coding::literals && !has_literal_block_stream_) {
+    return Coding::back_references;
+  }
+  return coding;
+}
+
+auto Compressor::change_coding(Coding coding) -> void {
+  if (num_uncompressed_bytes_in_block_ > 0) {
+    cut_block(undecided_bytes_.size());
+  }
+  coding_ = coding;
+  for (const auto &block_stream_with_maximum_block_size : block_streams_) {
+    if (is_candidate(block_stream_with_maximum_block_size)) {
+      block_stream_with_maximum_block_size.block_stream->clear_history();
+    }
+  }
+  if (coding_ == Coding::back_references) {
+    sampled_token_counters_ = token_counters_();
+  }
+}
+
+auto Compressor::adjust_effort() -> void {
+  const auto now = std::clock();
+  const auto seconds = static_cast<double>(now - effort_interval_start_) /
+                       static_cast<double>(CLOCKS_PER_SEC);
+  effort_interval_start_ = now;
+  if (effort_controller_->step(effort_interval, seconds)) {
+    set_effort_(effort_controller_->effort());
+  }
+}
+
+auto Compressor::commit_smallest(bool is_last) -> void {
+  BlockStream *smallest_compressed_block_stream = nullptr;
+  std::size_t smallest_compressed_block_size =
+      std::numeric_limits<std::size_t>::max();
+  for (const auto &block_stream_with_maximum_block_size : block_streams_) {
+    if (!is_candidate(block_stream_with_maximum_block_size) ||
+        num_uncompressed_bytes_in_block_ >
+            block_stream_with_maximum_block_size
+                .maximum_uncompressed_bytes_in_block) {
+      continue;
+    }
+    const auto compressed_block_size =
+        block_stream_with_maximum_block_size.block_stream->bits(is_last);
+    if (compressed_block_size < smallest_compressed_block_size) {
+      smallest_compressed_block_size = compressed_block_size;
+      smallest_compressed_block_stream =
+          block_stream_with_maximum_block_size.block_stream.get();
+    }
+  }
+  smallest_compressed_block_stream->commit(is_last);
+}
+
+auto Compressor::put_into_block(std::uint8_t byte) -> void {
+  for (const auto &block_stream_with_maximum_block_size : block_streams_) {
+    if (!is_candidate(block_stream_with_maximum_block_size) ||
+        num_uncompressed_bytes_in_block_ >=
+            block_stream_with_maximum_block_size
+                .maximum_uncompressed_bytes_in_block) {
+      continue;
+    }
+    block_stream_with_maximum_block_size.block_stream->put(byte);
+  }
+  num_uncompressed_bytes_in_block_++;
+}
+
+auto Compressor::is_block_memory_exhausted() const -> bool {
+  if (num_uncompressed_bytes_in_block_ == 0 ||
+      num_uncompressed_bytes_in_block_ % block_memory_check_interval != 0) {
+    return false;
+  }
+  std::size_t memory = 0;
+  for (const auto &block_stream_with_maximum_block_size : block_streams_) {
+    memory += block_stream_with_maximum_block_size.block_stream->memory();
+  }
+  return memory >= options_.max_block_memory;
+}
+
+auto Compressor::step_byte_change_point_detector(std::uint8_t byte) -> bool {
+  // The detector was tuned with bytes stepped as chars, as they are read from
+  // stdin, so bytes above 127 are negative and ignored by it. Carried bytes
+  // are replayed the same way, so that the statistics of a block do not
+  // depend on whether its bytes were carried.
+  return byte_change_point_detector_.step(static_cast<char>(byte));
+}
+
+auto Compressor::cut_block_if_needed() -> void {
+  if (const auto coding = this->coding(); coding != coding_) {
+    change_coding(coding);
+  } else if (is_byte_change_point_detected_) {
+    cut_block(std::min(byte_change_point_detector_.change_point_lag(),
+                       undecided_bytes_.size()));
+  } else if (is_symbol_change_point_detected_) {
+    // The symbols were emitted from bytes that have already been put into
+    // the block streams, so the block is cut where it stands.
+    cut_block(undecided_bytes_.size());
+  } else if (num_uncompressed_bytes_in_block_ >=
+                 (coding_ == Coding::stored ? block_streams_.front()
+                                    .maximum_uncompressed_bytes_in_block
+                              : maximum_of_maximum_uncompressed_block_sizes_) ||
+             is_block_memory_exhausted()) {
+    cut_block(undecided_bytes_.size());
+  }
+  is_byte_change_point_detected_ = false;
+}
+
+auto Compressor::cut_block(std::size_t num_carried_bytes) -> void {
+  while (undecided_bytes_.size() > num_carried_bytes) {
+    put_into_block(undecided_bytes_.dequeue());
+  }
+  commit_smallest(false);
+  for (const auto &block_stream_with_maximum_block_size : block_streams_) {
+    block_stream_with_maximum_block_size.block_stream->reset();
+  }
+  num_uncompressed_bytes_in_block_ = 0;
+  // Symbols are only emitted for bytes that have been put into the block
+  // streams, so only the byte detector needs to see the carried bytes.
+  symbol_change_point_detector_.reset();
+  is_symbol_change_point_detected_ = false;
+  byte_change_point_detector_.reset();
+  if (is_byte_change_point_detection_) {
+    for (const auto byte : undecided_bytes_) {
+      step_byte_change_point_detector(byte);
+    }
+  }
+}
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <vector>
+
+#include "block_type.hpp"
+#include "block_type_2.hpp"
+#include "change_point_detection.hpp"
+#include "constants.hpp"
+#include "effort_controller.hpp"
+#include "entropy_sampler.hpp"
+#include "gz.hpp"
+#include "lzss.hpp"
+#include "options.hpp"
+#include "ring_buffer.hpp"
+
+// The maximum number of bytes by which a block can be cut before the byte at
+// which its change point was detected. Bytes carried into the next block are
+// replayed through the change point detector, so this must be smaller than
+// its warmup to guarantee that replaying does not itself detect a change
+// point.
+constexpr std::size_t maximum_change_point_lag = 1U << 12U;
+static_assert(maximum_change_point_lag <
+              static_cast<std::size_t>(
+                  default_change_point_detector_params.warmup));
+
+// The budget for the memory a compressor holds regardless of its input: the
+// compressor itself and its block streams, at the largest window. Memory
+// allocated for the current block and for the patterns in the look-back
+// buffer comes on top of this, and grows with the input (see the README).
+constexpr std::size_t maximum_fixed_context_size = 1U << 17U;
+
+// The budget for the memory a compressor holds once it has been flushed, at
+// the largest window: its fixed state, the first chunk of the arena of its
+// block streams of type 2, and the patterns in its look-back buffer, of which
+// there are at most as many as the window. Flushing frees the rest of the
+// memory of its blocks, however large they were (see the README).
+constexpr std::size_t maximum_idle_context_size = 1U << 19U;
+
+// Compressor writes the bytes put into it to a gz file, cutting them into
+// blocks and committing each block as whichever block type is smallest.
+class Compressor {
+public:
+  // Write the gz header to out, to which the compressed bytes are written.
+  Compressor(std::ostream &out, const Options &options);
+
+  ~Compressor() = default;
+
+  Compressor(const Compressor &) = delete;
+  Compressor(Compressor &&) = delete;
+  auto operator=(const Compressor &) -> Compressor & = delete;
+  auto operator=(Compressor &&) -> Compressor & = delete;
+
+  // Set the size of the whole input, from which the throughput needed to
+  // meet the deadline in the options follows. An input smaller than the
+  // warmup of the change point detector can never be cut at a change point,
+  // so change point detection is skipped entirely for it. This must be called
+  // before any byte is put, and is called by compress itself.
+  auto set_input_size(std::size_t size) -> void;
+
+  auto put(std::uint8_t byte) -> void;
+
+  // Put bytes as the whole of the input, and finish.
+  auto compress(std::span<const std::uint8_t> bytes) -> void;
+
+  // Commit the bytes put so far, followed by an empty block of type 0 that
+  // ends the output on a byte boundary, and flush the output so that a
+  // decoder can read all of the bytes put so far. A full flush also clears
+  // the look-back buffers, so that decoding can start from the flush. The
+  // memory kept to buffer blocks is freed, so that a flushed compressor holds
+  // at most maximum_idle_context_size bytes.
+  auto flush(Flush flush) -> void;
+
+  // Commit the last block and write the gz footer.
+  auto finish() -> void;
+
+  // Return the counts of the work done by the match finder of the block
+  // stream of type 2, whose searches are throttled once the chain visits
+  // earned by the input are exhausted.
+  [[nodiscard]] auto match_finder_counters() const -> MatchFinderCounters {
+    return match_finder_counters_();
+  }
+
+  // Return whether the input is stepped through a change point detector.
+  [[nodiscard]] auto is_change_point_detection() const -> bool {
+    return is_byte_change_point_detection_ ||
+           is_symbol_change_point_detection_;
+  }
+
+  // Return the number of bytes put since the last flush.
+  [[nodiscard]] auto num_unflushed_bytes() const -> std::size_t {
+    return num_unflushed_bytes_;
+  }
+
+private:
+  // BlockStreamWithMaximumBlockSize describes a block stream along with
+  // the maximum number of uncompressed bytes that should be stored in a
+  // block within its stream, and the coding of the input that it is a
+  // candidate for. The block stream of type 0 is a candidate for every
+  // coding.
+  struct BlockStreamWithMaximumBlockSize {
+    std::unique_ptr<BlockStream> block_stream;
+    std::size_t maximum_uncompressed_bytes_in_block;
+    Coding coding = Coding::back_references;
+  };
+
+  std::ostream &out_;
+  Options options_;
+  bool is_byte_change_point_detection_;
+  bool is_symbol_change_point_detection_;
+
+  // Track the CRC of the uncompressed data to store in the gz footer.
+  std::uint32_t crc_{};
+
+  gz::BitStream stream_;
+
+  std::uint32_t num_uncompressed_bytes_in_file_{0};
+  // The number of uncompressed bytes that have been put into the block
+  // streams for the current block.
+  std::uint32_t num_uncompressed_bytes_in_block_{0};
+  std::size_t num_unflushed_bytes_{0};
+
+  // Only the detector for the selected change point symbols is stepped.
+  FixedPointCusumDistributionDetector<> byte_change_point_detector_;
+  FixedPointCusumDistributionDetector<num_literal_length_symbols +
+                                      num_distance_symbols>
+      symbol_change_point_detector_;
+  bool is_byte_change_point_detected_ = false;
+  bool is_symbol_change_point_detected_ = false;
+
+  // Regions of the input that look incompressible are stored in blocks of
+  // type 0 without being put into the other block streams. The entropy of
+  // each sample of the input is measured as it is read, while its bytes are
+  // still undecided, so that a region is stored from its first sample.
+  bool is_incompressible_region_detection_;
+  EntropySampler<> entropy_sampler_;
+  bool is_incompressible_region_ = false;
+  // The coding of the current block, which is stored in an incompressible
+  // region, and otherwise follows the effort.
+  Coding coding_ = Coding::back_references;
+  // The token counters of the block stream of type 2 when the previous
+  // sample was completed.
+  block_type_2::TokenCounters sampled_token_counters_;
+
+  // Given a target throughput, the effort is adjusted after every
+  // effort_interval bytes, from the CPU time taken since the last adjustment.
+  // Literals only are then coded by a block stream of their own, unless the
+  // block stream of type 2 codes literals only itself.
+  bool is_effort_control_;
+  std::optional<EffortController> effort_controller_;
+  std::clock_t effort_interval_start_{};
+  bool has_literal_block_stream_ = false;
+
+  // Read the counters of, and set the effort of, the block stream of type 2.
+  // These are set as the block streams are made, so they are declared before
+  // them.
+  std::function<MatchFinderCounters()> match_finder_counters_;
+  std::function<block_type_2::TokenCounters()> token_counters_;
+  std::function<void(const Effort &)> set_effort_;
+
+  // The block streams of the block types that are candidates for each block,
+  // starting with block type 0. Streams are only made for candidates, since
+  // each holds the look-back state of its own tokenizer.
+  std::vector<BlockStreamWithMaximumBlockSize> block_streams_;
+  std::size_t maximum_of_maximum_uncompressed_block_sizes_{0};
+
+  // Bytes that have been stepped through the change point detector, but not
+  // yet put into the block streams. Once a change point is detected, the
+  // current block is cut at the estimated location of the change (up to the
+  // capacity of this buffer before the detection), and the remaining bytes
+  // are carried into the next block.
+  RingBuffer<std::uint8_t, maximum_change_point_lag> undecided_bytes_;
+  static_assert(entropy_sample_size <= maximum_change_point_lag);
+
+  // Make the block streams for the strategy and window selected in the
+  // options. The block streams of the LZSS strategy are instantiated for each
+  // window in supported_windows; the other strategies do not look back beyond
+  // the previous byte, so they are instantiated once.
+  auto make_block_streams() -> std::vector<BlockStreamWithMaximumBlockSize>;
+
+  template <std::uint16_t LookBackSize,
+            typename Tokenizer = Lzss<LookBackSize, maximum_look_ahead_size>>
+  auto make_block_streams() -> std::vector<BlockStreamWithMaximumBlockSize>;
+
+  // Whether a block stream is a candidate for the current block, under its
+  // coding.
+  [[nodiscard]] auto is_candidate(
+      const BlockStreamWithMaximumBlockSize &block_stream_with_maximum_block_size)
+      const -> bool;
+
+  // Whether the sample just completed, and the bytes tokenized since the
+  // previous sample, look incompressible, counting the tokenized bytes afresh
+  // from here. Unless back references are being searched for, the bytes are
+  // not tokenized by the match finder, so only the entropy is known.
+  auto is_incompressible_sample() -> bool;
+
+  // Return the coding that the current block should have.
+  [[nodiscard]] auto coding() const -> Coding;
+
+  // Switch to another coding, cutting the current block. The block streams
+  // that become candidates have not seen the bytes since they last were, so
+  // their look-back buffers are cleared.
+  auto change_coding(Coding coding) -> void;
+
+  // Step the effort controller with the CPU time taken by the last
+  // effort_interval bytes, and apply the effort it chooses.
+  auto adjust_effort() -> void;
+
+  // Commit the smallest compressed block from any of the block streams.
+  auto commit_smallest(bool is_last) -> void;
+
+  auto put_into_block(std::uint8_t byte) -> void;
+
+  // Step the byte change point detector with a byte, returning whether a
+  // change point was detected.
+  auto step_byte_change_point_detector(std::uint8_t byte) -> bool;
+
+  // Whether the memory used to buffer the current block across the block
+  // streams has reached its maximum.
+  [[nodiscard]] auto is_block_memory_exhausted() const -> bool;
+
+  // Cut the current block if a change point was detected or the block is
+  // full. This is only done once there are more bytes to put, so that the
+  // last block is never cut.
+  auto cut_block_if_needed() -> void;
+
+  // Commit the current block with all but the last num_carried_bytes of the
+  // undecided bytes, then restart change point detection from the start of
+  // the next block.
+  auto cut_block(std::size_t num_carried_bytes) -> void;
+};
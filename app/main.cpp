@@ -1,153 +1,103 @@
-#include <algorithm>
-#include <array>
-#include <cstddef>
 #include <cstdint>
 #include <iostream>
-#include <limits>
-#include <memory>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "compressor.hpp"
+#include "content_type.hpp"
+#include "options.hpp"
+
+namespace {
+
+// Wait up to timeout milliseconds for input on stdin. Return false if none
+// has arrived by then.
+auto wait_for_input(int timeout) -> bool {
+  pollfd input{.fd = STDIN_FILENO, .events = POLLIN, .revents = 0};
+  // Errors and hang-ups are reported as input, so that the next read sees
+  // them.
+  return poll(&input, 1, timeout) != 0;
+}
 
-#define CRCPP_USE_CPP11
-#include "third_party/CRC.h"
+} // namespace
 
-#include "block_type.hpp"
-#include "block_type_0.hpp"
-#include "block_type_1.hpp"
-#include "block_type_2.hpp"
-#include "change_point_detection.hpp"
-#include "constants.hpp"
-#include "gz.hpp"
+auto main(int argc, char *argv[]) -> int {
+  const std::span args(argv + 1, argc - 1);
+  Options options;
+  try {
+    options = parse_options(args);
+  } catch (const std::invalid_argument &error) {
+    std::cerr << error.what() << "\n\n" << usage();
+    return 1;
+  }
 
-// BlockStreamWithMaximumBlockSize describes a block stream along with
-// the maximum number of uncompressed bytes that should be stored in a
-// block within its stream.
-struct BlockStreamWithMaximumBlockSize {
-  std::unique_ptr<BlockStream> block_stream;
-  std::size_t maximum_uncompressed_bytes_in_block;
-};
+  // The throughput needed to meet a deadline follows from the size of the
+  // input, which is only known up front for a regular file.
+  struct stat input_status {};
+  const auto is_input_size_known = fstat(STDIN_FILENO, &input_status) == 0 &&
+                                   S_ISREG(input_status.st_mode);
+  if (options.deadline_ms && !is_input_size_known) {
+    std::cerr << "cgzip: --deadline requires the input to be a regular file\n";
+    return 1;
+  }
 
-auto main() -> int {
+  // Buffer stdin and stdout separately from C stdio, which is not used, so
+  // that whether any input is buffered can be checked before waiting for it.
+  std::ios::sync_with_stdio(false);
   // Untie stdin from stdout to avoid flushing output before each read
   std::cin.tie(nullptr);
 
-  // Track the CRC of the uncompressed data to store in the gz footer.
-  auto crc_table = CRC::CRC_32().MakeTable();
-  std::uint32_t crc{};
-
-  gz::BitStream stream{std::cout};
-  stream.push_header();
-
-  // We need to see ahead of the stream by one character (e.g. to know, once we
-  // fill up a block, whether there are more blocks coming), so at each step,
-  // next_byte will be the next byte from the stream that is NOT in a block.
-  char next_byte{};
-
-  std::uint32_t num_uncompressed_bytes_in_file{0};
-  std::uint32_t num_uncompressed_bytes_in_block{0};
-
-  const auto block_streams_with_maximum_block_sizes =
-      std::array<BlockStreamWithMaximumBlockSize, 3>{
-          BlockStreamWithMaximumBlockSize{
-              .block_stream = std::make_unique<
-                  block_type_0::Stream<block_type_0::maximum_capacity>>(stream),
-              .maximum_uncompressed_bytes_in_block =
-                  block_type_0::maximum_capacity},
-          // Block type 1 is only suitable for small blocks, where the overhead
-          // of block type 2 is comparatively large. Since the warmup period for
-          // the change point detector is larger than the maximum desirable size
-          // of a block of type 1, disable block type 1 entirely by setting its
-          // breakpoint to 0. This improves speed by reducing the number of LZSS
-          // searches.
-          BlockStreamWithMaximumBlockSize{
-              .block_stream = std::make_unique<block_type_1::Stream<
-                  maximum_look_back_size, maximum_look_ahead_size>>(stream),
-              .maximum_uncompressed_bytes_in_block = 0},
-          BlockStreamWithMaximumBlockSize{
-              .block_stream = std::make_unique<block_type_2::Stream<
-                  maximum_look_back_size, maximum_look_ahead_size>>(stream),
-              .maximum_uncompressed_bytes_in_block = 1U << 30U}};
-
-  // Initialize a change point detector with empirically determined parameters.
-  CusumDistributionDetector change_point_detector(
-      {.warmup = 1U << 13U, // NOLINT (cppcoreguidelines-avoid-magic-numbers)
-       .threshold = 1e3});  // NOLINT (cppcoreguidelines-avoid-magic-numbers)
-
-  const auto maximum_of_maximum_uncompressed_block_sizes =
-      std::ranges::max_element(block_streams_with_maximum_block_sizes,
-                               [](const auto &a, const auto &b) {
-                                 return a.maximum_uncompressed_bytes_in_block <
-                                        b.maximum_uncompressed_bytes_in_block;
-                               })
-          ->maximum_uncompressed_bytes_in_block;
+  // Sniff the profile from a sample of the start of the input, which is put
+  // first.
+  std::vector<std::uint8_t> sample;
+  if (options.is_profile_sniffed) {
+    sample.resize(content_type_sample_size);
+    std::cin.read(reinterpret_cast<char *>(sample.data()),
+                  static_cast<std::streamsize>(sample.size()));
+    sample.resize(static_cast<std::size_t>(std::cin.gcount()));
+    options =
+        parse_options(args, content_type_profile(sniff_content_type(sample)));
+  }
 
-  // Commit the smallest compressed block from any of the block streams.
-  auto commit_smallest = [&block_streams_with_maximum_block_sizes,
-                          &num_uncompressed_bytes_in_block](bool is_last) {
-    std::uint8_t smallest_compressed_block_type =
-        std::numeric_limits<std::uint8_t>::max();
-    std::size_t smallest_compressed_block_size =
-        std::numeric_limits<std::size_t>::max();
-    for (auto i = 0; i < block_streams_with_maximum_block_sizes.size(); ++i) {
-      if (num_uncompressed_bytes_in_block >
-          block_streams_with_maximum_block_sizes.at(i)
-              .maximum_uncompressed_bytes_in_block) {
-        continue;
-      }
-      const auto compressed_block_size =
-          block_streams_with_maximum_block_sizes.at(i).block_stream->bits(
-              is_last);
-      if (compressed_block_size < smallest_compressed_block_size) {
-        smallest_compressed_block_size = compressed_block_size;
-        smallest_compressed_block_type = static_cast<std::uint8_t>(i);
-      }
+  Compressor compressor(std::cout, options);
+  if (is_input_size_known) {
+    compressor.set_input_size(input_status.st_size);
+  }
+  const auto put = [&compressor, &options](std::uint8_t byte) {
+    compressor.put(byte);
+    if (compressor.num_unflushed_bytes() >= options.flush_bytes) {
+      compressor.flush(options.flush);
     }
-    block_streams_with_maximum_block_sizes.at(smallest_compressed_block_type)
-        .block_stream->commit(is_last);
   };
-
-  if (std::cin.get(next_byte)) {
-    num_uncompressed_bytes_in_file++;
-    num_uncompressed_bytes_in_block++;
-    crc = CRC::Calculate(&next_byte, 1, crc_table);
-    while (true) {
-      for (const auto &block_stream_with_maximum_block_size :
-           block_streams_with_maximum_block_sizes) {
-        if (num_uncompressed_bytes_in_block >=
-            block_stream_with_maximum_block_size
-                .maximum_uncompressed_bytes_in_block) {
-          continue;
-        }
-        block_stream_with_maximum_block_size.block_stream->put(next_byte);
-      }
-      const auto is_change_point_detected =
-          change_point_detector.step(next_byte);
-      if (!std::cin.get(next_byte)) {
-        break;
-      }
-      num_uncompressed_bytes_in_file++;
-      num_uncompressed_bytes_in_block++;
-      crc = CRC::Calculate(&next_byte, 1, crc_table, crc);
-
-      if (is_change_point_detected ||
-          num_uncompressed_bytes_in_block >=
-              maximum_of_maximum_uncompressed_block_sizes) {
-        commit_smallest(false);
-        for (const auto &block_stream_with_maximum_block_size :
-             block_streams_with_maximum_block_sizes) {
-          block_stream_with_maximum_block_size.block_stream->reset();
-        }
-        change_point_detector.reset();
-        num_uncompressed_bytes_in_block = 0;
-      }
+  for (const auto byte : sample) {
+    put(byte);
+  }
+  char byte{};
+  while (true) {
+    if (options.flush_ms && compressor.num_unflushed_bytes() > 0 &&
+        std::cin.rdbuf()->in_avail() == 0 &&
+        !wait_for_input(*options.flush_ms)) {
+      compressor.flush(options.flush);
     }
-
-    commit_smallest(true);
-
-    // Pad to byte boundary before returning from deflate bitstream to gz
-    // bitstream
-    stream.flush_byte();
+    if (!std::cin.get(byte)) {
+      break;
+    }
+    put(static_cast<std::uint8_t>(byte));
+  }
+  compressor.finish();
+
+  if (const auto counters = compressor.match_finder_counters();
+      counters.num_throttled_searches > 0) {
+    std::cerr << "cgzip: the input exhausted the chain visits of the match "
+                 "finder, so "
+              << counters.num_throttled_searches << " of "
+              << counters.num_searches
+              << " searches for repeated strings were throttled\n";
   }
-
-  stream.push_footer(crc, num_uncompressed_bytes_in_file);
 
   return 0;
 }
@@ -0,0 +1,369 @@
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "options.hpp"
+
+namespace {
+
+// Return the profile with the given name, or none if the profile is to be
+// sniffed.
+auto parse_profile(std::string_view value) -> const Profile * {
+  if (value == "auto") {
+    return nullptr;
+  }
+  const auto profile = std::ranges::find(profiles, value, &Profile::name);
+  if (profile == profiles.end()) {
+    throw std::invalid_argument("Unknown profile: " + std::string(value));
+  }
+  return &*profile;
+}
+
+auto apply_profile(Options &options, const Profile &profile) {
+  options.strategy = profile.strategy;
+  options.block_splitter = profile.block_splitter;
+  options.reparse_passes = profile.reparse_passes;
+  options.chain_visits = profile.chain_visits;
+}
+
+auto parse_change_point_symbols(std::string_view value) -> ChangePointSymbols {
+  if (value == "bytes") {
+    return ChangePointSymbols::bytes;
+  }
+  if (value == "tokens") {
+    return ChangePointSymbols::tokens;
+  }
+  throw std::invalid_argument("Unknown change point symbols: " +
+                              std::string(value));
+}
+
+auto parse_strategy(std::string_view value) -> Strategy {
+  if (value == "lzss") {
+    return Strategy::lzss;
+  }
+  if (value == "huffman-only") {
+    return Strategy::huffman_only;
+  }
+  if (value == "rle") {
+    return Strategy::rle;
+  }
+  throw std::invalid_argument("Unknown strategy: " + std::string(value));
+}
+
+auto parse_block_splitter(std::string_view value) -> BlockSplitter {
+  if (value == "cusum") {
+    return BlockSplitter::cusum;
+  }
+  if (value == "cost") {
+    return BlockSplitter::cost;
+  }
+  throw std::invalid_argument("Unknown block splitter: " + std::string(value));
+}
+
+auto parse_incompressible_regions(std::string_view value)
+    -> IncompressibleRegions {
+  if (value == "store") {
+    return IncompressibleRegions::store;
+  }
+  if (value == "compress") {
+    return IncompressibleRegions::compress;
+  }
+  throw std::invalid_argument("Unknown incompressible regions: " +
+                              std::string(value));
+}
+
+// Parse a positive number of bytes, optionally followed by a binary suffix
+// (K, M or G).
+auto parse_size(std::string_view value) -> std::size_t {
+  const auto invalid_size = [value] {
+    return std::invalid_argument("Invalid size: " + std::string(value));
+  };
+  std::size_t size = 0;
+  const auto *const end = value.data() + value.size();
+  const auto [suffix, error] = std::from_chars(value.data(), end, size);
+  if (error != std::errc() || size == 0) {
+    throw invalid_size();
+  }
+  const std::string_view unit(suffix, end);
+  unsigned shift = 0;
+  if (unit == "K") {
+    shift = 10; // NOLINT (cppcoreguidelines-avoid-magic-numbers)
+  } else if (unit == "M") {
+    shift = 20; // NOLINT (cppcoreguidelines-avoid-magic-numbers)
+  } else if (unit == "G") {
+    shift = 30; // NOLINT (cppcoreguidelines-avoid-magic-numbers)
+  } else if (!unit.empty()) {
+    throw invalid_size();
+  }
+  if (size > (std::numeric_limits<std::size_t>::max() >> shift)) {
+    throw invalid_size();
+  }
+  return size << shift;
+}
+
+auto parse_window(std::string_view value) -> std::uint16_t {
+  const auto window = parse_size(value);
+  if (std::ranges::find(supported_windows, window) ==
+      supported_windows.end()) {
+    throw std::invalid_argument("Unsupported window: " + std::string(value));
+  }
+  return static_cast<std::uint16_t>(window);
+}
+
+auto parse_reparse_passes(std::string_view value) -> std::uint8_t {
+  unsigned passes = 0;
+  const auto *const end = value.data() + value.size();
+  const auto [last, error] = std::from_chars(value.data(), end, passes);
+  if (error != std::errc() || last != end ||
+      passes > maximum_num_reparse_passes) {
+    throw std::invalid_argument("Invalid reparse passes: " +
+                                std::string(value));
+  }
+  return static_cast<std::uint8_t>(passes);
+}
+
+auto parse_chain_visits(std::string_view value) -> std::uint16_t {
+  std::size_t visits = 0;
+  const auto *const end = value.data() + value.size();
+  const auto [last, error] = std::from_chars(value.data(), end, visits);
+  if (error != std::errc() || last != end || visits == 0 ||
+      visits > maximum_chain_visits) {
+    throw std::invalid_argument("Invalid chain visits: " +
+                                std::string(value));
+  }
+  return static_cast<std::uint16_t>(visits);
+}
+
+auto parse_change_point_threshold(std::string_view value) -> double {
+  double threshold = 0.0;
+  const auto *const end = value.data() + value.size();
+  const auto [last, error] = std::from_chars(value.data(), end, threshold);
+  if (error != std::errc() || last != end || !(threshold > 0.0)) {
+    throw std::invalid_argument("Invalid change point threshold: " +
+                                std::string(value));
+  }
+  return threshold;
+}
+
+auto parse_flush(std::string_view value) -> Flush {
+  if (value == "sync") {
+    return Flush::sync;
+  }
+  if (value == "full") {
+    return Flush::full;
+  }
+  throw std::invalid_argument("Unknown flush: " + std::string(value));
+}
+
+auto parse_milliseconds(std::string_view value) -> int {
+  int milliseconds = 0;
+  const auto *const end = value.data() + value.size();
+  const auto [last, error] = std::from_chars(value.data(), end, milliseconds);
+  if (error != std::errc() || last != end || milliseconds <= 0) {
+    throw std::invalid_argument("Invalid milliseconds: " + std::string(value));
+  }
+  return milliseconds;
+}
+
+auto parse_target_mbps(std::string_view value) -> std::size_t {
+  std::size_t mbps = 0;
+  const auto *const end = value.data() + value.size();
+  const auto [last, error] = std::from_chars(value.data(), end, mbps);
+  if (error != std::errc() || last != end || mbps == 0) {
+    throw std::invalid_argument("Invalid target MB/s: " + std::string(value));
+  }
+  return mbps;
+}
+
+// Parse a positive duration in seconds, optionally followed by s, or in
+// milliseconds, followed by ms, into milliseconds.
+auto parse_deadline(std::string_view value) -> int {
+  const auto invalid_deadline = [value] {
+    return std::invalid_argument("Invalid deadline: " + std::string(value));
+  };
+  int duration = 0;
+  const auto *const end = value.data() + value.size();
+  const auto [suffix, error] = std::from_chars(value.data(), end, duration);
+  if (error != std::errc() || duration <= 0) {
+    throw invalid_deadline();
+  }
+  const std::string_view unit(suffix, end);
+  if (unit == "ms") {
+    return duration;
+  }
+  constexpr int milliseconds_per_second = 1000;
+  if ((unit != "s" && !unit.empty()) ||
+      duration > std::numeric_limits<int>::max() / milliseconds_per_second) {
+    throw invalid_deadline();
+  }
+  return duration * milliseconds_per_second;
+}
+
+} // namespace
+
+auto parse_options(std::span<char *> args, const Profile &sniffed_profile)
+    -> Options {
+  // Each argument is paired with its value first, so that the profile can be
+  // applied before the arguments that override it, wherever it appears.
+  std::vector<std::pair<std::string_view, std::string_view>> args_and_values;
+  for (std::size_t i = 0; i < args.size(); ++i) {
+    std::string_view arg = args[i];
+    std::string_view value;
+    if (const auto separator = arg.find('='); separator != arg.npos) {
+      value = arg.substr(separator + 1);
+      arg = arg.substr(0, separator);
+    } else if (i + 1 < args.size()) {
+      value = args[++i];
+    } else {
+      throw std::invalid_argument("Missing value for argument: " +
+                                  std::string(arg));
+    }
+    args_and_values.emplace_back(arg, value);
+  }
+
+  Options options;
+  const Profile *profile = nullptr;
+  // Sniffing waits for a sample of the input, which would hold back the
+  // flushes of a stream that arrives slowly, so the general profile is used
+  // when flushing instead.
+  bool is_flushing = false;
+  for (const auto &[arg, value] : args_and_values) {
+    if (arg == "--profile") {
+      profile = parse_profile(value);
+    } else if (arg == "--flush-bytes" || arg == "--flush-ms") {
+      is_flushing = true;
+    }
+  }
+  options.is_profile_sniffed = profile == nullptr && !is_flushing;
+  apply_profile(options, profile != nullptr ? *profile
+                         : options.is_profile_sniffed ? sniffed_profile
+                                                      : profiles.front());
+
+  for (const auto &[arg, value] : args_and_values) {
+    if (arg == "--profile") {
+      // Applied above.
+    } else if (arg == "--strategy") {
+      options.strategy = parse_strategy(value);
+    } else if (arg == "--block-splitter") {
+      options.block_splitter = parse_block_splitter(value);
+    } else if (arg == "--change-point-symbols") {
+      options.change_point_symbols = parse_change_point_symbols(value);
+    } else if (arg == "--incompressible-regions") {
+      options.incompressible_regions = parse_incompressible_regions(value);
+    } else if (arg == "--window") {
+      options.window = parse_window(value);
+    } else if (arg == "--reparse-passes") {
+      options.reparse_passes = parse_reparse_passes(value);
+    } else if (arg == "--chain-visits") {
+      options.chain_visits = parse_chain_visits(value);
+    } else if (arg == "--change-point-threshold") {
+      options.change_point_detector_params.threshold =
+          parse_change_point_threshold(value);
+    } else if (arg == "--target-mbps") {
+      options.target_mbps = parse_target_mbps(value);
+    } else if (arg == "--deadline") {
+      options.deadline_ms = parse_deadline(value);
+    } else if (arg == "--max-block-memory") {
+      options.max_block_memory = parse_size(value);
+    } else if (arg == "--flush") {
+      options.flush = parse_flush(value);
+    } else if (arg == "--flush-bytes") {
+      options.flush_bytes = parse_size(value);
+    } else if (arg == "--flush-ms") {
+      options.flush_ms = parse_milliseconds(value);
+    } else {
+      throw std::invalid_argument("Unknown argument: " + std::string(arg));
+    }
+  }
+  return options;
+}
+
+auto usage() -> std::string_view {
+  return "usage: cgzip [options] < input > output.gz\n"
+         "\n"
+         "options:\n"
+         "  --profile auto|general|text|dna|binary\n"
+         "      Start from the parameters tuned for a type of content, which\n"
+         "      the options below override. By default, the type is sniffed\n"
+         "      from the first 4K of the input, unless --flush-bytes or\n"
+         "      --flush-ms is given, in which case the general profile is "
+         "used.\n"
+         "      The sniffed profiles split blocks by cost; the defaults "
+         "marked\n"
+         "      (general) below are those of the general profile.\n"
+         "  --strategy lzss|huffman-only|rle\n"
+         "      Tokenize the input by searching for the longest repeated "
+         "strings\n"
+         "      (general), into literals only, or into runs of a byte only. "
+         "The\n"
+         "      last two are much faster, and --window does not apply to "
+         "them.\n"
+         "  --block-splitter cusum|cost\n"
+         "      Cut blocks at change points detected using CUSUM "
+         "(general), or\n"
+         "      split chunks of the input into blocks wherever doing so is\n"
+         "      estimated to save bits (sniffed profiles).\n"
+         "  --change-point-symbols bytes|tokens\n"
+         "      Step the change point detector with the input bytes "
+         "(default),\n"
+         "      or with the literal/length and distance symbols of the "
+         "tokenizer,\n"
+         "      when CUSUM is selected.\n"
+         "  --incompressible-regions store|compress\n"
+         "      Store regions of the input that look incompressible as soon "
+         "as\n"
+         "      they are detected (default), or compress them as the rest of "
+         "the\n"
+         "      input.\n"
+         "  --window 4K|8K|16K|32K\n"
+         "      Reach back up to this many bytes for repeated strings "
+         "(default:\n"
+         "      32K). Smaller windows use less memory per stream, at the "
+         "cost of\n"
+         "      compression ratio.\n"
+         "  --reparse-passes 0-4\n"
+         "      Re-parse each block up to this many times with the costs of "
+         "its\n"
+         "      own prefix codes, dropping or shortening back references "
+         "that\n"
+         "      cost more than their literals (general: 0).\n"
+         "  --chain-visits 1-4096\n"
+         "      Visit at most this many occurrences of each repeated string\n"
+         "      when searching for the longest (general: 4096).\n"
+         "  --change-point-threshold NATS\n"
+         "      Cut a block once the evidence of a change in the input reaches\n"
+         "      NATS, when CUSUM is selected (default: 1000).\n"
+         "  --target-mbps MBPS\n"
+         "      Search less thoroughly, or store the input, as needed to "
+         "compress\n"
+         "      at least MBPS megabytes of input per second.\n"
+         "  --deadline DURATION[s|ms]\n"
+         "      As for --target-mbps, with the throughput needed to compress "
+         "the\n"
+         "      whole input within DURATION, which requires the input to be "
+         "a\n"
+         "      regular file.\n"
+         "  --max-block-memory SIZE[K|M|G]\n"
+         "      Cut a block once the memory used to buffer it reaches SIZE\n"
+         "      bytes (default: unlimited).\n"
+         "  --flush sync|full\n"
+         "      Flush the output by ending it on a byte boundary (default), "
+         "or\n"
+         "      by also forgetting the input so far, so that decoding can "
+         "start\n"
+         "      from the flush.\n"
+         "  --flush-bytes SIZE[K|M|G]\n"
+         "      Flush the output every SIZE bytes of input.\n"
+         "  --flush-ms MS\n"
+         "      Flush the output once no input has arrived for MS "
+         "milliseconds.\n";
+}
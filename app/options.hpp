@@ -0,0 +1,183 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string_view>
+
+#include "change_point_detection.hpp"
+#include "constants.hpp"
+#include "content_type.hpp"
+#include "lzss.hpp"
+
+// ChangePointSymbols selects the stream of symbols that the change point
+// detector is stepped with.
+enum class ChangePointSymbols : std::uint8_t {
+  // The uncompressed input bytes.
+  bytes,
+  // The literal/length and distance symbols emitted by the block type 2
+  // tokenizer, i.e. the symbols whose statistics determine the size of a
+  // block of type 2.
+  tokens,
+};
+
+// BlockSplitter selects how the input is split into blocks.
+enum class BlockSplitter : std::uint8_t {
+  // Cut blocks at change points in the distribution of the input, detected
+  // using CUSUM.
+  cusum,
+  // Split chunks of the input into blocks of type 2 wherever doing so is
+  // estimated to save bits, based on the symbol counts of candidate blocks.
+  cost,
+};
+
+// Strategy selects how the input is tokenized into literals and back
+// references, following the strategies of zlib.
+enum class Strategy : std::uint8_t {
+  // Search the look-back buffer for the longest match with LZSS.
+  lzss,
+  // Only literals, so that blocks are compressed by their prefix codes alone
+  // (Z_HUFFMAN_ONLY).
+  huffman_only,
+  // Only runs of a byte, as back references with a distance of one (Z_RLE).
+  rle,
+};
+
+// IncompressibleRegions selects what is done with regions of the input that
+// look incompressible, e.g. media files that are already compressed.
+enum class IncompressibleRegions : std::uint8_t {
+  // Store them in blocks of type 0 as soon as they are detected, without
+  // tokenizing them.
+  store,
+  // Compress them as the rest of the input, leaving each block to be stored
+  // only if that is smallest.
+  compress,
+};
+
+// Flush selects what is written when the output is flushed, following the
+// flush modes of zlib.
+enum class Flush : std::uint8_t {
+  // Write all of the input so far, ending on a byte boundary (Z_SYNC_FLUSH).
+  sync,
+  // As for sync, and also forget the input so far, so that decoding can
+  // start from the flush (Z_FULL_FLUSH).
+  full,
+};
+
+// The windows for which the block streams are instantiated. Smaller windows
+// shrink the look-back state of each stream, at the cost of compression ratio.
+constexpr std::array<std::uint16_t, 4> supported_windows{
+    1U << 12U, 1U << 13U, 1U << 14U, 1U << 15U};
+static_assert(supported_windows.back() == maximum_look_back_size);
+
+// The most times that the prefix codes of a block of type 2 may be rebuilt
+// from a re-parse of its tokens.
+constexpr std::uint8_t maximum_num_reparse_passes = 4;
+
+// The parameters of the change point detector, determined empirically. The
+// warmup is the minimum number of bytes in a block cut by a change point.
+constexpr CusumDistributionDetectorParams
+    default_change_point_detector_params{
+        .warmup = 1U << 13U,
+        .threshold = 1e3}; // NOLINT (cppcoreguidelines-avoid-magic-numbers)
+
+// Profile is a set of parameters tuned for a type of content. The options
+// start from a profile, and any other argument overrides its parameters.
+struct Profile {
+  std::string_view name;
+  Strategy strategy;
+  BlockSplitter block_splitter;
+  std::uint8_t reparse_passes;
+  std::uint16_t chain_visits;
+};
+
+// The profiles, starting with the general profile, which holds the defaults of
+// the options, followed by the profile of each content type in the order of
+// ContentType. Cost-based block splitting is smaller than CUSUM on every type
+// of content. The alphabet of DNA is so small that back references save less
+// than the runs and the prefix codes that they break up, so it is not searched
+// at all. Periodic binary content (e.g. kennedy.xls, ptt5) has long chains, of
+// which the first 1024 occurrences find nearly all of the savings in about
+// 15% less time, while text rarely reaches the end of its chains either way.
+constexpr std::array profiles{
+    Profile{.name = "general",
+            .strategy = Strategy::lzss,
+            .block_splitter = BlockSplitter::cusum,
+            .reparse_passes = 0,
+            .chain_visits = maximum_chain_visits},
+    Profile{.name = "text",
+            .strategy = Strategy::lzss,
+            .block_splitter = BlockSplitter::cost,
+            .reparse_passes = 0,
+            .chain_visits = maximum_chain_visits},
+    Profile{.name = "dna",
+            .strategy = Strategy::rle,
+            .block_splitter = BlockSplitter::cost,
+            .reparse_passes = 0,
+            .chain_visits = maximum_chain_visits},
+    Profile{.name = "binary",
+            .strategy = Strategy::lzss,
+            .block_splitter = BlockSplitter::cost,
+            .reparse_passes = 1,
+            .chain_visits = 1U << 10U},
+};
+
+// Return the profile tuned for a content type.
+constexpr auto content_type_profile(ContentType content_type)
+    -> const Profile & {
+  return profiles.at(1 + static_cast<std::size_t>(content_type));
+}
+
+struct Options {
+  // Whether the profile is sniffed from the start of the input (the default,
+  // unless flushing with --flush-bytes or --flush-ms), in which case the
+  // options must be parsed again with the profile sniffed.
+  bool is_profile_sniffed = true;
+  Strategy strategy = Strategy::lzss;
+  BlockSplitter block_splitter = BlockSplitter::cusum;
+  ChangePointSymbols change_point_symbols = ChangePointSymbols::bytes;
+  IncompressibleRegions incompressible_regions = IncompressibleRegions::store;
+  // The number of bytes that back references can reach back. One of the
+  // windows in supported_windows.
+  std::uint16_t window = maximum_look_back_size;
+  // The number of times each block of type 2 is re-parsed with the costs of
+  // its own prefix codes, at most maximum_num_reparse_passes. Zero disables
+  // re-parsing.
+  std::uint8_t reparse_passes = 0;
+  // The most occurrences of a pattern that each search of the match finder
+  // visits, from one to maximum_chain_visits.
+  std::uint16_t chain_visits = maximum_chain_visits;
+  CusumDistributionDetectorParams change_point_detector_params =
+      default_change_point_detector_params;
+  // Lower the effort spent compressing as needed to compress at least this
+  // many megabytes (10^6 bytes) of input per second of CPU time.
+  std::optional<std::size_t> target_mbps;
+  // Lower the effort spent compressing as needed to compress the whole input
+  // within this many milliseconds of CPU time, which requires its size to be
+  // known up front.
+  std::optional<int> deadline_ms;
+  // The maximum number of bytes of memory used to buffer a block before it
+  // is cut, regardless of whether a change point has been detected.
+  std::size_t max_block_memory = std::numeric_limits<std::size_t>::max();
+  Flush flush = Flush::sync;
+  // Flush the output once this many bytes have been read since the last
+  // flush.
+  std::size_t flush_bytes = std::numeric_limits<std::size_t>::max();
+  // Flush the output once no input has arrived for this many milliseconds
+  // since the last byte that was read.
+  std::optional<int> flush_ms;
+};
+
+// Parse the command line arguments (excluding the program name) into options,
+// starting from the profile selected by the arguments wherever it appears, or
+// from sniffed_profile if it is to be sniffed. Throws std::invalid_argument if
+// an argument is not recognized.
+auto parse_options(std::span<char *> args,
+                   const Profile &sniffed_profile = profiles.front())
+    -> Options;
+
+// Return a description of the command line arguments.
+auto usage() -> std::string_view;
@@ -36,6 +36,7 @@
           packages = with pkgs; [
             cmake
             catch2_3
+            zlib
             python313
             llvmPackages_20.clang-tools
             flamegraph.packages.${system}.default
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Arena is a memory resource that hands out memory by bumping an offset
+// through the chunk it allocated last. Deallocating does nothing; instead,
+// reset makes all of its memory available again at once, e.g. at the end of
+// each block. Chunks are kept across resets, so once the arena has grown to
+// fit the largest of recent blocks, allocating from it no longer touches the
+// heap.
+class Arena final : public std::pmr::memory_resource {
+public:
+  static constexpr std::size_t default_initial_size = 1U << 16U;
+  // The most times as much memory as was needed since the last reset that the
+  // arena keeps across a reset.
+  static constexpr std::size_t maximum_unused_factor = 4;
+
+  explicit Arena(std::size_t initial_size = default_initial_size)
+      : initial_size_{initial_size} {}
+
+  // Make all memory allocated from the arena available again. None of it may
+  // be in use. If more than one chunk was needed since the last reset, the
+  // chunks are replaced by a single chunk as large as all of them, so that as
+  // much can be allocated again without growing. If instead the arena holds
+  // more than maximum_unused_factor times what was needed (and its initial
+  // size), it is trimmed to a single chunk of what was needed, so that one
+  // large block does not keep its memory held for every block after it.
+  auto reset() -> void {
+    const auto capacity = this->capacity();
+    const auto needed = std::max(size_, initial_size_);
+    if (capacity > maximum_unused_factor * needed) {
+      chunks_.clear();
+      add_chunk(needed);
+    } else if (chunks_.size() > 1) {
+      chunks_.clear();
+      add_chunk(capacity);
+    }
+    offset_ = 0;
+    size_ = 0;
+  }
+
+  // Make all memory allocated from the arena available again, as for reset,
+  // and free all of its chunks, e.g. while the memory is not expected to be
+  // needed for some time. None of it may be in use.
+  auto release() -> void {
+    chunks_.clear();
+    offset_ = 0;
+    size_ = 0;
+  }
+
+  // Return the number of bytes allocated from the arena since it was last
+  // reset, including memory that has since been deallocated.
+  [[nodiscard]] auto size() const -> std::size_t { return size_; }
+
+  // Return the number of bytes held by the arena.
+  [[nodiscard]] auto capacity() const -> std::size_t {
+    std::size_t size = 0;
+    for (const auto &chunk : chunks_) {
+      size += chunk.size;
+    }
+    return size;
+  }
+
+private:
+  struct Chunk {
+    std::unique_ptr<std::byte[]> bytes; // NOLINT (*-avoid-c-arrays)
+    std::size_t size;
+  };
+
+  std::size_t initial_size_;
+  std::vector<Chunk> chunks_;
+  // The number of bytes allocated from the last chunk.
+  std::size_t offset_ = 0;
+  std::size_t size_ = 0;
+
+  auto add_chunk(std::size_t size) -> void {
+    chunks_.push_back(Chunk{
+        // NOLINTNEXTLINE (*-avoid-c-arrays)
+        .bytes = std::make_unique_for_overwrite<std::byte[]>(size),
+        .size = size});
+    offset_ = 0;
+  }
+
+  // Return memory for bytes at the given alignment from the last chunk, or
+  // nullptr if it does not fit.
+  auto allocate_from_last_chunk(std::size_t bytes, std::size_t alignment)
+      -> void * {
+    if (chunks_.empty()) {
+      return nullptr;
+    }
+    auto &chunk = chunks_.back();
+    void *pointer = chunk.bytes.get() + offset_;
+    auto space = chunk.size - offset_;
+    if (std::align(alignment, bytes, pointer, space) == nullptr) {
+      return nullptr;
+    }
+    const auto offset = chunk.size - space + bytes;
+    size_ += offset - offset_;
+    offset_ = offset;
+    return pointer;
+  }
+
+  auto do_allocate(std::size_t bytes, std::size_t alignment)
+      -> void * override {
+    if (auto *pointer = allocate_from_last_chunk(bytes, alignment)) {
+      return pointer;
+    }
+    // Grow geometrically, so that a block needs few chunks before they are
+    // coalesced.
+    add_chunk(std::max({bytes + alignment, initial_size_,
+                        chunks_.empty() ? 0 : 2 * chunks_.back().size}));
+    return allocate_from_last_chunk(bytes, alignment);
+  }
+
+  auto do_deallocate(void * /*pointer*/, std::size_t /*bytes*/,
+                     std::size_t /*alignment*/) -> void override {}
+
+  [[nodiscard]] auto do_is_equal(const std::pmr::memory_resource &other) const
+      noexcept -> bool override {
+    return this == &other;
+  }
+};
+
+// FreeList is a memory resource for containers that allocate many blocks of
+// the same small size, such as the nodes of a hash map. Blocks of that size
+// are carved from an arena and, once deallocated, kept on a list to be handed
+// out again. Blocks of any other size (e.g. the buckets of a hash map) are
+// allocated from the upstream resource.
+class FreeList final : public std::pmr::memory_resource {
+public:
+  static constexpr std::size_t maximum_block_size = 64;
+
+  explicit FreeList(
+      std::pmr::memory_resource &upstream = *std::pmr::new_delete_resource())
+      : upstream_{upstream} {}
+
+private:
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+
+  std::pmr::memory_resource &upstream_;
+  Arena arena_;
+  FreeBlock *free_blocks_ = nullptr;
+  // The size and alignment of the blocks on the list, decided by the first
+  // allocation small enough to be kept.
+  std::size_t block_size_ = 0;
+  std::size_t block_alignment_ = 0;
+
+  auto is_listed(std::size_t bytes, std::size_t alignment) -> bool {
+    if (block_size_ == 0 && bytes >= sizeof(FreeBlock) &&
+        bytes <= maximum_block_size && alignment >= alignof(FreeBlock)) {
+      block_size_ = bytes;
+      block_alignment_ = alignment;
+    }
+    return bytes == block_size_ && alignment == block_alignment_;
+  }
+
+  auto do_allocate(std::size_t bytes, std::size_t alignment)
+      -> void * override {
+    if (!is_listed(bytes, alignment)) {
+      return upstream_.allocate(bytes, alignment);
+    }
+    if (free_blocks_ == nullptr) {
+      return arena_.allocate(bytes, alignment);
+    }
+    return std::exchange(free_blocks_, free_blocks_->next);
+  }
+
+  auto do_deallocate(void *pointer, std::size_t bytes, std::size_t alignment)
+      -> void override {
+    if (!is_listed(bytes, alignment)) {
+      upstream_.deallocate(pointer, bytes, alignment);
+      return;
+    }
+    free_blocks_ = ::new (pointer) FreeBlock{.next = free_blocks_};
+  }
+
+  [[nodiscard]] auto do_is_equal(const std::pmr::memory_resource &other) const
+      noexcept -> bool override {
+    return this == &other;
+  }
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <vector>
+
+#include "constants.hpp"
+
+// The block splitter chooses where to split a run of tokens into blocks of
+// type 2 by estimating the encoded size of candidate blocks directly from
+// their symbol counts, without computing prefix codes.
+//
+// Reference:
+// https://github.com/google/zopfli/blob/master/src/zopfli/blocksplitter.c
+namespace block_splitter {
+
+constexpr std::size_t num_symbols =
+    num_literal_length_symbols + num_distance_symbols;
+
+// Counts of literal/length symbols, followed by counts of distance symbols.
+using Counts = std::array<std::uint32_t, num_symbols>;
+
+// Estimate the number of bits in a block of type 2 (including its block
+// header and end-of-block symbol) containing the symbols counted in end but
+// not in begin, where begin and end are cumulative counts.
+auto estimate_bits(const Counts &begin, const Counts &end) -> double;
+
+// Choose block boundaries among the candidate boundaries described by
+// cumulative_counts, where cumulative_counts[i] counts the symbols before the
+// i-th candidate boundary. Blocks are split recursively wherever splitting is
+// estimated to save bits, then adjacent blocks are merged wherever merging is
+// estimated to save bits. Return the indices of the chosen boundaries,
+// starting with 0 and ending with cumulative_counts.size() - 1.
+auto split(std::span<const Counts> cumulative_counts)
+    -> std::vector<std::size_t>;
+
+// As above, but allocate the boundaries and all scratch memory from resource.
+auto split(std::span<const Counts> cumulative_counts,
+           std::pmr::memory_resource &resource)
+    -> std::pmr::vector<std::size_t>;
+
+} // namespace block_splitter
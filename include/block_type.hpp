@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 class BlockStream {
@@ -16,9 +17,20 @@ public:
   // Return the number of bits in the compressed block.
   [[nodiscard]] virtual auto bits(bool is_last) -> std::uint64_t = 0;
 
+  // Return the number of bytes of memory used to buffer the current block.
+  [[nodiscard]] virtual auto memory() const -> std::size_t = 0;
+
   // Reset the current block in the block stream.
   virtual auto reset() -> void = 0;
 
+  // Reset the current block, and free the memory kept to buffer blocks, e.g.
+  // once the output has been flushed and the stream may be idle.
+  virtual auto release_memory() -> void = 0;
+
+  // Forget the bytes of the blocks before the current block, so that the
+  // blocks that follow do not refer back to them.
+  virtual auto clear_history() -> void = 0;
+
   // Add a byte to the current block in the block stream.
   virtual auto put(std::uint8_t byte) -> void = 0;
 
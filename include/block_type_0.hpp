@@ -21,9 +21,10 @@ private:
   std::vector<std::uint8_t> block_;
 
 public:
-  explicit Stream(gz::BitStream &bit_stream) : out_{bit_stream} {
-    block_.reserve(Capacity);
-  }
+  // The block grows to fit the bytes put into it, rather than reserving its
+  // capacity up front, so that a stream holding little input holds little
+  // memory.
+  explicit Stream(gz::BitStream &bit_stream) : out_{bit_stream} {}
 
   [[nodiscard]] auto bits(bool /*is_last*/) -> std::uint64_t override {
     return (
@@ -38,8 +39,20 @@ public:
     );
   }
 
+  [[nodiscard]] auto memory() const -> std::size_t override {
+    return block_.size();
+  }
+
   auto reset() -> void override { block_.clear(); }
 
+  auto release_memory() -> void override {
+    block_.clear();
+    block_.shrink_to_fit();
+  }
+
+  // Blocks of type 0 never refer back to earlier blocks.
+  auto clear_history() -> void override {}
+
   auto put(std::uint8_t byte) -> void override {
     if (block_.size() == Capacity) {
       throw std::logic_error(
@@ -54,9 +67,7 @@ public:
     out_.flush_byte();
     out_.push(static_cast<std::uint16_t>(block_.size()));
     out_.push(static_cast<std::uint16_t>(~block_.size()));
-    for (const auto literal : block_) {
-      out_.push(literal);
-    }
+    out_.push_bytes(block_);
   }
 
   [[nodiscard]] static auto capacity() -> std::size_t { return Capacity; }
@@ -2,8 +2,12 @@
 
 #include <algorithm>
 #include <array>
+#include <cstddef>
 #include <cstdint>
+#include <memory_resource>
+#include <vector>
 
+#include "arena.hpp"
 #include "block_type.hpp"
 #include "constants.hpp"
 #include "deflate.hpp"
@@ -14,84 +18,125 @@
 
 namespace block_type_1 {
 
+namespace detail {
+
+// Distances are coded by symbol (rather than tabulated per distance) to keep
+// the tables small.
+constexpr auto build_distance_code_words()
+    -> std::array<CodeWord, num_distance_symbols> {
+  std::array<CodeWord, num_distance_symbols> code_words{};
+  for (std::uint16_t symbol = 0; symbol < num_distance_symbols; ++symbol) {
+    code_words.at(symbol) = CodeWord::from_prefix_code(PrefixCode{
+        .bits = symbol,
+        .length = 5}); // NOLINT (cppcoreguidelines-avoid-magic-numbers)
+  }
+  return code_words;
+}
+
+constexpr auto build_literal_length_code_words()
+    -> std::array<CodeWord, num_literal_length_symbols> {
+  std::array<std::uint8_t, num_literal_length_symbols> lengths{};
+  // NOLINTBEGIN (cppcoreguidelines-avoid-magic-numbers)
+  std::fill(lengths.begin(), lengths.begin() + 144, 8);
+  std::fill(lengths.begin() + 144, lengths.begin() + 256, 9);
+  std::fill(lengths.begin() + 256, lengths.begin() + 280, 7);
+  std::fill(lengths.begin() + 280, lengths.end(), 8);
+  // NOLINTEND (cppcoreguidelines-avoid-magic-numbers)
+  const auto prefix_codes_by_symbol =
+      prefix_codes<num_literal_length_symbols>(lengths);
+  std::array<CodeWord, num_literal_length_symbols> code_words{};
+  for (std::size_t symbol = 0; symbol < num_literal_length_symbols; ++symbol) {
+    code_words.at(symbol) =
+        CodeWord::from_prefix_code(prefix_codes_by_symbol.at(symbol));
+  }
+  return code_words;
+}
+
+} // namespace detail
+
+// The code words of the fixed prefix codes, which are shared with block type
+// 2 to encode its blocks as blocks of type 1 where that is smaller.
+constexpr std::array<CodeWord, num_literal_length_symbols>
+    literal_length_code_words{detail::build_literal_length_code_words()};
+constexpr std::array<CodeWord, num_distance_symbols> distance_code_words{
+    detail::build_distance_code_words()};
+
 template <std::uint16_t LookBackSize = maximum_look_back_size,
           std::uint16_t LookAheadSize = maximum_look_ahead_size>
 class Stream final : public BlockStream {
 private:
-  deflate::BufferedBitStream buffered_out_;
-  Lzss<LookBackSize, LookAheadSize> lzss_;
+  // A literal (length 0), or a back reference.
+  struct Token {
+    std::uint16_t length;
+    std::uint16_t distance_or_literal;
+  };
 
-  static constexpr auto build_distance_prefix_codes_with_offsets()
-      -> std::array<PrefixCodeWithOffset, LookBackSize + 1> {
-    std::array<PrefixCodeWithOffset, LookBackSize + 1>
-        prefix_codes_with_offsets{};
-    for (auto distance = minimum_back_reference_distance;
-         distance <= LookBackSize; ++distance) {
-      const auto &symbol_with_offset =
-          SymbolWithOffset::from_distance(distance);
-      prefix_codes_with_offsets.at(distance) = PrefixCodeWithOffset{
-          .prefix_code =
-              PrefixCode{
-                  .bits = symbol_with_offset.symbol,
-                  .length =
-                      5}, // NOLINT (cppcoreguidelines-avoid-magic-numbers)
-          .offset = symbol_with_offset.offset};
-    }
-    return prefix_codes_with_offsets;
-  }
-
-  static constexpr auto build_literal_length_prefix_codes()
-      -> std::array<PrefixCode, num_literal_length_symbols> {
-    std::array<std::uint8_t, num_literal_length_symbols> lengths{};
-    // NOLINTBEGIN (cppcoreguidelines-avoid-magic-numbers)
-    std::fill(lengths.begin(), lengths.begin() + 144, 8);
-    std::fill(lengths.begin() + 144, lengths.begin() + 256, 9);
-    std::fill(lengths.begin() + 256, lengths.begin() + 280, 7);
-    std::fill(lengths.begin() + 280, lengths.end(), 8);
-    // NOLINTEND (cppcoreguidelines-avoid-magic-numbers)
-    return prefix_codes<num_literal_length_symbols>(lengths);
-  }
+  deflate::BitStream out_;
+  Lzss<LookBackSize, LookAheadSize> lzss_;
+  // The memory of the block is allocated from the arena, which is reset
+  // along with the block.
+  Arena arena_;
+  // Tokens are kept unencoded until the block is committed, along with the
+  // number of bits they encode to, so that a block that is not committed is
+  // never encoded.
+  std::pmr::vector<Token> block_{&arena_};
+  std::uint64_t num_token_bits_ = 0;
 
-  static constexpr auto build_length_prefix_codes_with_offsets(
-      const std::array<PrefixCode, num_literal_length_symbols>
-          literal_length_prefix_codes)
-      -> std::array<PrefixCodeWithOffset, LookAheadSize + 1> {
-    std::array<PrefixCodeWithOffset, LookAheadSize + 1>
-        prefix_codes_with_offsets{};
+  // The fixed codes are written as code words, with the offset of each length
+  // fused into its code word, so that a back reference is written with two
+  // writes.
+  static constexpr auto build_length_code_words(
+      const std::array<CodeWord, num_literal_length_symbols>
+          literal_length_code_words)
+      -> std::array<CodeWord, LookAheadSize + 1> {
+    std::array<CodeWord, LookAheadSize + 1> code_words{};
     for (auto length = minimum_back_reference_length; length <= LookAheadSize;
          ++length) {
       const auto &symbol_with_offset = SymbolWithOffset::from_length(length);
-      prefix_codes_with_offsets.at(length) =
-          PrefixCodeWithOffset{.prefix_code = literal_length_prefix_codes.at(
-                                   symbol_with_offset.symbol),
-                               .offset = symbol_with_offset.offset};
+      code_words.at(length) =
+          literal_length_code_words.at(symbol_with_offset.symbol)
+              .with_offset(symbol_with_offset.offset);
     }
-    return prefix_codes_with_offsets;
+    return code_words;
   }
 
-  static constexpr std::array<PrefixCode, num_literal_length_symbols>
-      literal_length_prefix_codes_{build_literal_length_prefix_codes()};
-  static constexpr std::array<PrefixCodeWithOffset, LookAheadSize + 1>
-      length_prefix_codes_with_offsets_{
-          build_length_prefix_codes_with_offsets(literal_length_prefix_codes_)};
-  static constexpr std::array<PrefixCodeWithOffset, LookBackSize + 1>
-      distance_prefix_codes_with_offsets_{
-          build_distance_prefix_codes_with_offsets()};
+  static constexpr const auto &literal_length_code_words_ =
+      literal_length_code_words;
+  static constexpr std::array<CodeWord, LookAheadSize + 1> length_code_words_{
+      build_length_code_words(literal_length_code_words_)};
+  static constexpr const auto &distance_code_words_ = distance_code_words;
 
 public:
-  explicit Stream(gz::BitStream &bit_stream) : buffered_out_{bit_stream} {}
+  explicit Stream(gz::BitStream &bit_stream) : out_{bit_stream} {}
 
   [[nodiscard]] auto bits(bool /*is_last*/) -> std::uint64_t override {
-    return (buffered_out_.bits() +
-            3 // is last flag (1 bit), block type (2 bits)
-            + literal_length_prefix_codes_.at(eob_symbol).length);
+    drain();
+    return (num_token_bits_ + 3 // is last flag (1 bit), block type (2 bits)
+            + literal_length_code_words_.at(eob_symbol).length);
+  }
+
+  [[nodiscard]] auto memory() const -> std::size_t override {
+    return arena_.size();
   }
 
   auto reset() -> void override {
-    while (!lzss_.is_empty()) {
-      step();
-    }
-    buffered_out_.reset();
+    drain();
+    // Release the tokens to the arena before resetting it.
+    block_ = std::pmr::vector<Token>(&arena_);
+    arena_.reset();
+    num_token_bits_ = 0;
+  }
+
+  auto release_memory() -> void override {
+    drain();
+    block_ = std::pmr::vector<Token>(&arena_);
+    arena_.release();
+    num_token_bits_ = 0;
+  }
+
+  auto clear_history() -> void override {
+    drain();
+    lzss_.clear_look_back();
   }
 
   auto put(std::uint8_t byte) -> void override {
@@ -103,46 +148,59 @@ public:
   }
 
   auto commit(bool is_last) -> void override {
-    auto &unbuffered_out = buffered_out_.unbuffered();
-    unbuffered_out.push_bit(is_last ? 1 : 0);
-    unbuffered_out.push_bits(1, 2);
+    out_.push_bit(is_last ? 1 : 0);
+    out_.push_bits(1, 2);
+    drain();
+    for (const auto &token : block_) {
+      if (token.length == 0) {
+        out_.push_code_word(
+            literal_length_code_words_.at(token.distance_or_literal));
+        continue;
+      }
+      out_.push_code_word(length_code_words_.at(token.length));
+      out_.push_code_word(distance_code_word(token.distance_or_literal));
+    }
+    out_.push_code_word(literal_length_code_words_.at(eob_symbol));
+  }
+
+private:
+  static constexpr auto distance_code_word(std::uint16_t distance)
+      -> CodeWord {
+    const auto symbol_with_offset = SymbolWithOffset::from_distance(distance);
+    return distance_code_words_.at(symbol_with_offset.symbol)
+        .with_offset(symbol_with_offset.offset);
+  }
+
+  auto drain() {
     while (!lzss_.is_empty()) {
       step();
     }
-    buffered_out_.commit();
-    unbuffered_out.push_prefix_code(
-        literal_length_prefix_codes_.at(eob_symbol));
   }
 
-private:
   auto step() {
     const auto backref = lzss_.back_reference();
     const auto byte = lzss_.literal();
-    const auto &prefix_code = literal_length_prefix_codes_.at(byte);
     if (backref.length >= minimum_back_reference_length) {
-      const auto &length_prefix_code_with_offset =
-          length_prefix_codes_with_offsets_.at(backref.length);
-      const auto &distance_prefix_code_with_offset =
-          distance_prefix_codes_with_offsets_.at(backref.distance);
       auto num_literal_bits = 0;
       for (auto i = lzss_.literals_in_back_reference_begin();
            i != lzss_.literals_in_back_reference_end(); ++i) {
-        num_literal_bits += literal_length_prefix_codes_.at(*i).length;
+        num_literal_bits += literal_length_code_words_.at(*i).length;
       }
       const auto num_back_reference_bits =
-          length_prefix_code_with_offset.prefix_code.length +
-          length_prefix_code_with_offset.offset.num_bits +
-          distance_prefix_code_with_offset.prefix_code.length +
-          distance_prefix_code_with_offset.offset.num_bits;
+          length_code_words_.at(backref.length).length +
+          distance_code_word(backref.distance).length;
       if (num_literal_bits >= num_back_reference_bits) {
-        buffered_out_.push_back_reference(PrefixCodedBackReference{
-            .length = length_prefix_code_with_offset,
-            .distance = distance_prefix_code_with_offset});
+        block_.push_back(
+            Token{.length = static_cast<std::uint16_t>(backref.length),
+                  .distance_or_literal =
+                      static_cast<std::uint16_t>(backref.distance)});
+        num_token_bits_ += num_back_reference_bits;
         lzss_.take_back_reference();
         return;
       }
     }
-    buffered_out_.push_prefix_code(prefix_code);
+    block_.push_back(Token{.length = 0, .distance_or_literal = byte});
+    num_token_bits_ += literal_length_code_words_.at(byte).length;
     lzss_.take_literal();
   }
 };
@@ -4,136 +4,616 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory_resource>
+#include <optional>
 #include <span>
-#include <stdexcept>
 #include <utility>
 #include <variant>
 #include <vector>
 
+#include "arena.hpp"
+#include "block_splitter.hpp"
 #include "block_type.hpp"
+#include "block_type_1.hpp"
+#include "code_length_runs.hpp"
+#include "code_lengths.hpp"
 #include "constants.hpp"
 #include "deflate.hpp"
 #include "gz.hpp"
+#include "histogram.hpp"
 #include "lzss.hpp"
-#include "package_merge.hpp"
 #include "prefix_codes.hpp"
 #include "types.hpp"
 
 namespace block_type_2 {
 
+// The numbers of bytes tokenized by a stream since it was made, and of the
+// literals among them, from which the share of the bytes covered by back
+// references follows.
+struct TokenCounters {
+  std::uint64_t num_bytes = 0;
+  std::uint64_t num_literals = 0;
+};
+
+// The tokens of a block are found by Tokenizer, which is Lzss unless a
+// strategy that skips its search is selected (see tokenizers.hpp).
 template <std::uint16_t LookBackSize = maximum_look_back_size,
-          std::uint16_t LookAheadSize = maximum_look_ahead_size>
+          std::uint16_t LookAheadSize = maximum_look_ahead_size,
+          typename Tokenizer = Lzss<LookBackSize, LookAheadSize>>
 class Stream final : public BlockStream {
 private:
-  deflate::BufferedBitStream buffered_out_;
-  Lzss<LookBackSize, LookAheadSize> lzss_;
-  std::array<std::size_t, num_literal_length_symbols + num_distance_symbols>
-      count_by_symbol_{};
-  std::vector<std::variant<std::uint16_t, Offset>> block_;
-  bool is_last_and_buffered_ = false;
+  struct CodeLengthOffset {
+    std::uint8_t bits;
+    std::uint8_t num_bits;
+  };
+
+  struct CodeLengthSymbolWithOffset {
+    std::uint8_t symbol;
+    CodeLengthOffset offset;
+  };
+
+  static constexpr std::uint16_t min_leading_literal_length_prefix_codes = 257;
+  static constexpr std::uint16_t min_leading_distance_prefix_codes = 1;
+  static constexpr std::uint16_t min_leading_code_length_prefix_codes = 4;
+  static constexpr std::uint8_t literal_length_header_num_bits = 5;
+  static constexpr std::uint8_t distance_header_num_bits = 5;
+  static constexpr std::uint8_t code_length_header_num_bits = 4;
+  static constexpr std::uint8_t code_length_num_bits = 3;
+  static constexpr std::uint8_t maximum_code_length = 7;
+  static constexpr std::uint16_t max_leading_literal_length_prefix_codes = 286;
+  // The order in which the code length code lengths are sent.
+  static constexpr std::array<std::uint8_t, num_code_length_symbols>
+      code_length_order{16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
+                        11, 4,  12, 3, 13, 2, 14, 1, 15};
+  // The maximum number of rounds of finding the optimal runs of the code
+  // lengths under the code length code of the previous round. Further
+  // rounds rarely find a smaller header.
+  static constexpr int maximum_header_rounds = 2;
+
+  // The dynamic Huffman header of a block: the number of code lengths of
+  // each alphabet that are sent, the code length code, and the run-length
+  // coded code lengths.
+  struct Header {
+    std::uint16_t num_leading_literal_length_prefix_codes;
+    std::uint16_t num_leading_distance_prefix_codes;
+    std::uint16_t num_leading_code_length_prefix_codes;
+    std::array<PrefixCode, num_code_length_symbols> code_length_prefix_codes;
+    std::array<PrefixCode, num_code_length_symbols>
+        reordered_code_length_prefix_codes;
+    std::pmr::vector<std::variant<std::uint8_t, CodeLengthSymbolWithOffset>>
+        cl_symbols;
+
+    [[nodiscard]] auto bits() const -> std::uint64_t {
+      std::uint64_t num_bits =
+          literal_length_header_num_bits + distance_header_num_bits +
+          code_length_header_num_bits +
+          (code_length_num_bits * num_leading_code_length_prefix_codes);
+      for (const auto &symbol_or_symbol_with_offset : cl_symbols) {
+        if (std::holds_alternative<CodeLengthSymbolWithOffset>(
+                symbol_or_symbol_with_offset)) {
+          const auto &symbol_with_offset =
+              std::get<CodeLengthSymbolWithOffset>(
+                  symbol_or_symbol_with_offset);
+          num_bits +=
+              code_length_prefix_codes.at(symbol_with_offset.symbol).length +
+              symbol_with_offset.offset.num_bits;
+        } else {
+          num_bits += code_length_prefix_codes
+                          .at(std::get<std::uint8_t>(
+                              symbol_or_symbol_with_offset))
+                          .length;
+        }
+      }
+      return num_bits;
+    }
+  };
+
+  // A header being considered for a block: its code lengths split into runs,
+  // and the code length code of the runs, along with its number of bits.
+  struct HeaderCandidate {
+    std::uint16_t num_leading_literal_length_prefix_codes;
+    std::uint16_t num_leading_code_length_prefix_codes;
+    std::size_t num_runs;
+    std::array<CodeLengthRun, maximum_num_code_lengths> runs;
+    std::array<std::uint8_t, num_code_length_symbols> code_length_lengths;
+    std::uint64_t bits;
+  };
+
+  // A position in the block, as an index into the tokens and into the
+  // uncompressed bytes they cover.
+  struct Position {
+    std::size_t token;
+    std::size_t byte;
+  };
+
+  // A block whose prefix codes and header have been decided, and whose exact
+  // size is known, but which has not been encoded. Only the planned blocks of
+  // the stream that is committed are ever encoded. The prefix codes are kept
+  // as code words, built once per block, so that each token is written
+  // without reversing its code. A block without a header is encoded with the
+  // fixed prefix codes, i.e. as a block of type 1.
+  struct PlannedBlock {
+    Position begin;
+    Position end;
+    std::array<CodeWord, num_literal_length_symbols> literal_length_code_words;
+    std::array<CodeWord, num_distance_symbols> distance_code_words;
+    std::optional<Header> header;
+    std::uint64_t bits;
+  };
+
+  deflate::BitStream out_;
+  Tokenizer tokenizer_;
+  // The memory of the block (its tokens and bytes, candidate boundaries and
+  // planned blocks, and the scratch memory of the block splitter) is
+  // allocated from the arena, which is reset along with the block.
+  Arena arena_;
+  Histogram<num_literal_length_symbols + num_distance_symbols>
+      count_by_symbol_;
+  // Tokens are packed into 32 bits. A literal is its byte. A back reference
+  // sets is_back_reference_bit, and holds its length (less the minimum length)
+  // in the low bits and its distance (less one) above them. Symbols and
+  // offsets are derived from the length and distance when the block is
+  // planned.
+  using Token = std::uint32_t;
+  static constexpr Token is_back_reference_bit = 1U << 31U;
+  static constexpr Token token_length_mask = 0xFFU;
+  static constexpr std::uint8_t token_distance_shift = 8;
+  static constexpr Token token_distance_mask = 0x7FFFU;
+  std::pmr::vector<Token> block_{&arena_};
+  // The uncompressed bytes of the block. The literals covered by a back
+  // reference are read from here when deciding between the back reference and
+  // its literals, rather than being copied into the tokens.
+  std::pmr::vector<std::uint8_t> bytes_{&arena_};
+  std::size_t num_tokenized_bytes_ = 0;
+  TokenCounters token_counters_;
+  std::pmr::vector<PlannedBlock> planned_blocks_{&arena_};
+  bool is_planned_ = false;
+  std::function<void(std::uint16_t)> symbol_listener_;
+
+  // When splitting blocks, the tokens of the block are split into several
+  // blocks of type 2 by the block splitter. Candidate boundaries are placed
+  // every num_tokens_between_candidate_boundaries tokens, where the
+  // cumulative symbol counts and the position in the block are recorded.
+  static constexpr std::size_t num_tokens_between_candidate_boundaries = 512;
+  bool split_blocks_;
+  std::pmr::vector<block_splitter::Counts> cumulative_counts_{&arena_};
+  std::pmr::vector<Position> cumulative_positions_{&arena_};
+  std::size_t num_tokens_since_candidate_boundary_ = 0;
+
+  // The most times that the prefix codes of a block are rebuilt from a
+  // re-parse of its tokens. When re-parsing, back references may also be
+  // shortened rather than only kept or dropped.
+  std::uint8_t num_reparse_passes_;
 
 public:
-  explicit Stream(gz::BitStream &bit_stream) : buffered_out_{bit_stream} {}
+  explicit Stream(gz::BitStream &bit_stream, bool split_blocks = false,
+                  std::uint8_t num_reparse_passes = 0)
+      : out_{bit_stream}, split_blocks_{split_blocks},
+        num_reparse_passes_{num_reparse_passes} {
+    add_candidate_boundary();
+  }
+
+  // Set a listener that is called with each literal/length and distance
+  // symbol as it is emitted by the tokenizer. Distance symbols are offset by
+  // num_literal_length_symbols. The end-of-block symbol is not reported.
+  auto set_symbol_listener(std::function<void(std::uint16_t)> listener)
+      -> void {
+    symbol_listener_ = std::move(listener);
+  }
+
+  // Return the counts of the work done by the match finder of the tokenizer,
+  // which are zero for a tokenizer that does not search.
+  [[nodiscard]] auto match_finder_counters() const -> MatchFinderCounters {
+    if constexpr (requires { tokenizer_.counters(); }) {
+      return tokenizer_.counters();
+    } else {
+      return {};
+    }
+  }
+
+  // Set the effort of the searches of the tokenizer from here on, if it
+  // searches: the most occurrences visited by each search, and the longest
+  // back reference whose positions are all indexed.
+  auto set_match_finder_effort(std::size_t maximum_chain_visits,
+                               std::size_t maximum_indexed_length) -> void {
+    if constexpr (requires {
+                    tokenizer_.set_maximum_chain_visits(maximum_chain_visits);
+                  }) {
+      tokenizer_.set_maximum_chain_visits(maximum_chain_visits);
+      tokenizer_.set_maximum_indexed_length(maximum_indexed_length);
+    }
+  }
+
+  // Return the counts of the tokens emitted since the stream was made.
+  [[nodiscard]] auto token_counters() const -> TokenCounters {
+    return token_counters_;
+  }
 
-  [[nodiscard]] auto bits(bool is_last) -> std::uint64_t override {
-    buffer(is_last);
-    return buffered_out_.bits();
+  [[nodiscard]] auto bits(bool /*is_last*/) -> std::uint64_t override {
+    plan();
+    std::uint64_t num_bits = 0;
+    for (const auto &planned_block : planned_blocks_) {
+      num_bits += planned_block.bits;
+    }
+    return num_bits;
   }
 
-  auto reset() -> void override {
-    count_by_symbol_.fill(0);
-    block_.clear();
-    buffered_out_.reset();
-    is_last_and_buffered_ = false;
+  [[nodiscard]] auto memory() const -> std::size_t override {
+    return arena_.size();
+  }
+
+  auto reset() -> void override { reset_block(false); }
+
+  auto release_memory() -> void override { reset_block(true); }
+
+  auto clear_history() -> void override {
+    while (!tokenizer_.is_empty()) {
+      step();
+    }
+    tokenizer_.clear_look_back();
   }
 
   auto put(std::uint8_t byte) -> void override {
-    lzss_.put(byte);
-    if (!lzss_.is_full()) {
+    bytes_.push_back(byte);
+    tokenizer_.put(byte);
+    if (!tokenizer_.is_full()) {
       return;
     }
     step();
   }
 
   auto commit(bool is_last) -> void override {
-    buffer(is_last);
-    buffered_out_.commit();
+    plan();
+    for (const auto &planned_block : planned_blocks_) {
+      out_.push_bit(is_last && &planned_block == &planned_blocks_.back() ? 1
+                                                                         : 0);
+      if (planned_block.header) {
+        out_.push_bits(2, 2);
+        push_header(*planned_block.header);
+      } else {
+        out_.push_bits(1, 2);
+      }
+      visit_tokens(
+          planned_block,
+          [this](const CodeWord &literal_code_word,
+                 std::uint8_t /*literal*/) {
+            out_.push_code_word(literal_code_word);
+          },
+          [this](const CodeWord &length_code_word,
+                 const CodeWord &distance_code_word,
+                 std::uint16_t /*length_symbol*/,
+                 std::uint16_t /*distance_symbol*/) {
+            out_.push_code_word(length_code_word);
+            out_.push_code_word(distance_code_word);
+          });
+      out_.push_code_word(
+          planned_block.literal_length_code_words.at(eob_symbol));
+    }
   }
 
 private:
-  auto buffer(bool is_last) {
-    if (buffered_out_.bits() > 0) {
-      // We have already buffered.
-      if (is_last_and_buffered_ != is_last) {
-        throw std::logic_error(
-            "Cannot re-buffer with different last block flag");
+  // Decide the blocks of type 2 that the tokens are split into, along with
+  // their prefix codes and exact sizes, without encoding them. Whether the
+  // block is the last block does not affect its size, so planning is done
+  // once per block regardless of how often the size is queried.
+  auto plan() {
+    if (is_planned_) {
+      return;
+    }
+    is_planned_ = true;
+
+    while (!tokenizer_.is_empty()) {
+      step();
+    }
+
+    if (!split_blocks_) {
+      plan_block(Position{.token = 0, .byte = 0},
+                 Position{.token = block_.size(), .byte = bytes_.size()},
+                 count_by_symbol_.counts());
+      return;
+    }
+
+    if (cumulative_positions_.back().token != block_.size() ||
+        cumulative_positions_.size() == 1) {
+      add_candidate_boundary();
+    }
+    const auto boundaries = block_splitter::split(cumulative_counts_, arena_);
+    for (std::size_t i = 0; i + 1 < boundaries.size(); ++i) {
+      const auto &begin_counts = cumulative_counts_.at(boundaries.at(i));
+      auto counts = cumulative_counts_.at(boundaries.at(i + 1));
+      for (std::size_t symbol = 0; symbol < counts.size(); ++symbol) {
+        counts.at(symbol) -= begin_counts.at(symbol);
       }
+      plan_block(cumulative_positions_.at(boundaries.at(i)),
+                 cumulative_positions_.at(boundaries.at(i + 1)), counts);
+    }
+  }
+
+  // Plan a single block containing the tokens in [begin, end) of block_,
+  // whose symbols are counted in count_by_symbol. The block is encoded with
+  // the fixed prefix codes instead of its own where that is smaller. The size
+  // with the fixed prefix codes follows from the symbol counts, and is
+  // compared with the exact size with the prefix codes and header of the
+  // block, as an estimate could pick the fixed prefix codes where they are
+  // larger.
+  auto plan_block(Position begin, Position end,
+                  block_splitter::Counts count_by_symbol) {
+    auto &planned_block = planned_blocks_.emplace_back(
+        PlannedBlock{.begin = begin,
+                     .end = end,
+                     .literal_length_code_words = {},
+                     .distance_code_words = {},
+                     .header = std::nullopt,
+                     .bits = 0});
+    const auto num_fixed_bits = fixed_block_bits(count_by_symbol);
+    count_by_symbol.at(eob_symbol)++;
+    plan_prefix_codes(planned_block, count_by_symbol);
+    count_bits(planned_block);
+    reparse(planned_block);
+    if (planned_block.bits <= num_fixed_bits) {
       return;
     }
+    planned_block.literal_length_code_words =
+        block_type_1::literal_length_code_words;
+    planned_block.distance_code_words = block_type_1::distance_code_words;
+    planned_block.header = std::nullopt;
+    count_bits(planned_block);
+  }
 
-    is_last_and_buffered_ = is_last;
+  // Re-parse a block with the costs of its own prefix codes: count the
+  // symbols chosen for its tokens with its prefix codes, which drop or
+  // shorten the back references that cost more than their literals, and
+  // rebuild the prefix codes from those counts. This is repeated while the
+  // block shrinks, up to num_reparse_passes_ times. The matches found by the
+  // tokenizer are kept as the only back references considered, so this is
+  // much cheaper than an optimal parse.
+  auto reparse(PlannedBlock &planned_block) {
+    for (std::uint8_t pass = 0; pass < num_reparse_passes_; ++pass) {
+      auto count_by_symbol = count_symbols(planned_block);
+      count_by_symbol.at(eob_symbol)++;
+      PlannedBlock reparsed_block{.begin = planned_block.begin,
+                                  .end = planned_block.end,
+                                  .literal_length_code_words = {},
+                                  .distance_code_words = {},
+                                  .header = std::nullopt,
+                                  .bits = 0};
+      plan_prefix_codes(reparsed_block, count_by_symbol);
+      count_bits(reparsed_block);
+      if (reparsed_block.bits >= planned_block.bits) {
+        return;
+      }
+      planned_block = std::move(reparsed_block);
+    }
+  }
 
-    buffered_out_.push_bit(is_last ? 1 : 0);
-    buffered_out_.push_bits(2, 2);
+  // Count the symbols chosen for the tokens of a block with its prefix
+  // codes, excluding the end-of-block symbol.
+  auto count_symbols(const PlannedBlock &planned_block) const
+      -> block_splitter::Counts {
+    block_splitter::Counts count_by_symbol{};
+    visit_tokens(
+        planned_block,
+        [&count_by_symbol](const CodeWord & /*literal_code_word*/,
+                           std::uint8_t literal) {
+          count_by_symbol[literal]++;
+        },
+        [&count_by_symbol](const CodeWord & /*length_code_word*/,
+                           const CodeWord & /*distance_code_word*/,
+                           std::uint16_t length_symbol,
+                           std::uint16_t distance_symbol) {
+          count_by_symbol[length_symbol]++;
+          count_by_symbol[num_literal_length_symbols + distance_symbol]++;
+        });
+    return count_by_symbol;
+  }
 
-    while (!lzss_.is_empty()) {
-      step();
+  // Return the number of bits in a block (including its end-of-block symbol)
+  // with the given symbol counts when encoded with the fixed prefix codes.
+  // This is exact unless encoding chooses the literals of some back reference
+  // over it, which only saves bits.
+  static auto fixed_block_bits(const block_splitter::Counts &count_by_symbol)
+      -> std::uint64_t {
+    std::uint64_t num_bits =
+        3 // is last flag (1 bit), block type (2 bits)
+        + block_type_1::literal_length_code_words.at(eob_symbol).length;
+    for (std::size_t symbol = 0; symbol < num_literal_length_symbols;
+         ++symbol) {
+      num_bits += std::uint64_t{count_by_symbol.at(symbol)} *
+                  (block_type_1::literal_length_code_words.at(symbol).length +
+                   num_offset_bits_by_symbol.at(symbol));
+    }
+    for (std::size_t symbol = 0; symbol < num_distance_symbols; ++symbol) {
+      num_bits +=
+          std::uint64_t{
+              count_by_symbol.at(num_literal_length_symbols + symbol)} *
+          (block_type_1::distance_code_words.at(symbol).length +
+           num_offset_bits_by_symbol.at(num_literal_length_symbols + symbol));
     }
+    return num_bits;
+  }
 
-    push_symbol(eob_symbol);
+  // Build the prefix codes of a block from its symbol counts (including the
+  // end-of-block symbol), along with the header that describes them.
+  auto plan_prefix_codes(PlannedBlock &planned_block,
+                         block_splitter::Counts &count_by_symbol) {
+    using Count = block_splitter::Counts::value_type;
+    const auto literal_length_prefix_code_lengths = code_lengths(
+        std::span<Count, num_literal_length_symbols>(
+            count_by_symbol.begin(),
+            count_by_symbol.begin() + num_literal_length_symbols),
+        maximum_prefix_code_length);
+    const auto distance_prefix_code_lengths =
+        code_lengths(std::span<Count, num_distance_symbols>(
+                         count_by_symbol.begin() + num_literal_length_symbols,
+                         count_by_symbol.end()),
+                     maximum_prefix_code_length);
+    const auto literal_length_prefix_codes =
+        prefix_codes(std::span<const std::uint8_t, num_literal_length_symbols>(
+            literal_length_prefix_code_lengths));
+    const auto distance_prefix_codes =
+        prefix_codes(std::span<const std::uint8_t, num_distance_symbols>(
+            distance_prefix_code_lengths));
+    planned_block.header = plan_header(literal_length_prefix_codes,
+                                       distance_prefix_codes, arena_);
+    for (std::size_t symbol = 0; symbol < num_literal_length_symbols;
+         ++symbol) {
+      planned_block.literal_length_code_words.at(symbol) =
+          CodeWord::from_prefix_code(literal_length_prefix_codes.at(symbol));
+    }
+    for (std::size_t symbol = 0; symbol < num_distance_symbols; ++symbol) {
+      planned_block.distance_code_words.at(symbol) =
+          CodeWord::from_prefix_code(distance_prefix_codes.at(symbol));
+    }
+  }
 
-    flush_block();
+  // Set the number of bits of a block from its prefix codes and header.
+  auto count_bits(PlannedBlock &planned_block) const {
+    std::uint64_t num_token_bits = 0;
+    visit_tokens(
+        planned_block,
+        [&num_token_bits](const CodeWord &literal_code_word,
+                          std::uint8_t /*literal*/) {
+          num_token_bits += literal_code_word.length;
+        },
+        [&num_token_bits](const CodeWord &length_code_word,
+                          const CodeWord &distance_code_word,
+                          std::uint16_t /*length_symbol*/,
+                          std::uint16_t /*distance_symbol*/) {
+          num_token_bits += length_code_word.length + distance_code_word.length;
+        });
+    planned_block.bits =
+        3 // is last flag (1 bit), block type (2 bits)
+        + (planned_block.header ? planned_block.header->bits() : 0) +
+        num_token_bits +
+        planned_block.literal_length_code_words.at(eob_symbol).length;
   }
 
-  auto push_symbol(const std::uint16_t symbol) {
-    count_by_symbol_.at(symbol)++;
-    block_.emplace_back(symbol);
+  // Reset the current block, freeing the chunks of the arena if
+  // is_memory_released, and otherwise keeping them for the next block.
+  auto reset_block(bool is_memory_released) -> void {
+    while (!tokenizer_.is_empty()) {
+      step();
+    }
+    count_by_symbol_.reset();
+    // Release the memory of the block to the arena before resetting it.
+    block_ = std::pmr::vector<Token>(&arena_);
+    bytes_ = std::pmr::vector<std::uint8_t>(&arena_);
+    planned_blocks_ = std::pmr::vector<PlannedBlock>(&arena_);
+    cumulative_counts_ = std::pmr::vector<block_splitter::Counts>(&arena_);
+    cumulative_positions_ = std::pmr::vector<Position>(&arena_);
+    if (is_memory_released) {
+      arena_.release();
+    } else {
+      arena_.reset();
+    }
+    num_tokenized_bytes_ = 0;
+    is_planned_ = false;
+    add_candidate_boundary();
   }
 
-  auto push_offset(const Offset &offset) { block_.emplace_back(offset); }
+  auto add_candidate_boundary() {
+    cumulative_counts_.push_back(count_by_symbol_.counts());
+    cumulative_positions_.push_back(
+        Position{.token = block_.size(), .byte = num_tokenized_bytes_});
+    num_tokens_since_candidate_boundary_ = 0;
+  }
 
-  auto push_back_reference() {
-    const auto back_reference = lzss_.back_reference();
-    const auto length_symbol_with_offset =
-        SymbolWithOffset::from_length(back_reference.length);
-    const auto distance_symbol_with_offset =
-        SymbolWithOffset::from_distance(back_reference.distance);
-    push_symbol(length_symbol_with_offset.symbol);
-    push_offset(length_symbol_with_offset.offset);
-    push_symbol(distance_symbol_with_offset.symbol +
-                num_literal_length_symbols);
-    push_offset(distance_symbol_with_offset.offset);
-    // Add the literals in the back reference to the block after the back
-    // reference so that we can decide between using the literals or the back
-    // reference when flushing the block.
-    for (auto i = lzss_.literals_in_back_reference_begin();
-         i != lzss_.literals_in_back_reference_end(); ++i) {
-      block_.emplace_back(*i);
+  auto push_symbol(const std::uint16_t symbol) {
+    count_by_symbol_.add(symbol);
+    if (symbol_listener_) {
+      symbol_listener_(symbol);
     }
   }
 
-  struct CodeLengthOffset {
-    std::uint8_t bits;
-    std::uint8_t num_bits;
-  };
+  auto push_back_reference() {
+    const auto back_reference = tokenizer_.back_reference();
+    push_symbol(SymbolWithOffset::from_length(back_reference.length).symbol);
+    push_symbol(
+        SymbolWithOffset::from_distance(back_reference.distance).symbol +
+        num_literal_length_symbols);
+    block_.push_back(
+        is_back_reference_bit |
+        static_cast<Token>(back_reference.length -
+                           minimum_back_reference_length) |
+        (static_cast<Token>(back_reference.distance - 1)
+         << token_distance_shift));
+    num_tokenized_bytes_ += back_reference.length;
+    token_counters_.num_bytes += back_reference.length;
+  }
 
-  struct CodeLengthSymbolWithOffset {
-    std::uint8_t symbol;
-    CodeLengthOffset offset;
-  };
+  auto push_literal(const std::uint8_t literal) {
+    push_symbol(literal);
+    block_.push_back(literal);
+    num_tokenized_bytes_++;
+    token_counters_.num_bytes++;
+    token_counters_.num_literals++;
+  }
 
-  struct CodeLengthSymbolBatch {
-    std::uint8_t symbol;
-    std::uint8_t offset_num_bits;
-    std::uint16_t min;
-    std::uint16_t max;
-  };
+  // Score a candidate header: build the code length code of its runs, and
+  // count its bits.
+  static auto evaluate_header(HeaderCandidate &candidate) {
+    std::array<std::uint16_t, num_code_length_symbols>
+        count_by_code_length_symbol{};
+    for (std::size_t i = 0; i < candidate.num_runs; ++i) {
+      count_by_code_length_symbol.at(candidate.runs.at(i).symbol)++;
+    }
+    candidate.code_length_lengths =
+        code_lengths(std::span<std::uint16_t, num_code_length_symbols>(
+                         count_by_code_length_symbol),
+                     maximum_code_length);
+    candidate.num_leading_code_length_prefix_codes =
+        num_code_length_symbols;
+    while (candidate.num_leading_code_length_prefix_codes >
+               min_leading_code_length_prefix_codes &&
+           candidate.code_length_lengths.at(code_length_order.at(
+               candidate.num_leading_code_length_prefix_codes - 1)) == 0) {
+      candidate.num_leading_code_length_prefix_codes--;
+    }
+    candidate.bits =
+        literal_length_header_num_bits + distance_header_num_bits +
+        code_length_header_num_bits +
+        (code_length_num_bits *
+         candidate.num_leading_code_length_prefix_codes);
+    for (std::size_t i = 0; i < candidate.num_runs; ++i) {
+      const auto symbol = candidate.runs.at(i).symbol;
+      candidate.bits += candidate.code_length_lengths.at(symbol) +
+                        num_extra_bits(symbol);
+    }
+  }
+
+  // The bits of each code length symbol under the code length code of a
+  // candidate, for finding the optimal runs of the next. A symbol the code
+  // leaves out is priced as if it were added with the longest code.
+  static auto symbol_bits(const HeaderCandidate &candidate) {
+    std::array<std::uint16_t, num_code_length_symbols> bits{};
+    for (std::size_t symbol = 0; symbol < num_code_length_symbols; ++symbol) {
+      const auto length = candidate.code_length_lengths.at(symbol);
+      bits.at(symbol) = length == 0 ? maximum_code_length : length;
+    }
+    return bits;
+  }
 
-  auto
-  flush_block_metadata(const std::array<PrefixCode, num_literal_length_symbols>
-                           &literal_length_prefix_codes,
-                       const std::array<PrefixCode, num_distance_symbols>
-                           &distance_prefix_codes) {
+  // Decide the header of a block with the given prefix codes, allocating its
+  // code length symbols from resource.
+  //
+  // The header is the smallest of several candidates. The first splits the
+  // code lengths into runs greedily. Each round then finds the optimal runs
+  // under the code length code of the best candidate so far, which changes
+  // the code, until a round finds no smaller header or leaves the code as it
+  // was. Sending one or two more literal/length code lengths is then tried,
+  // as their zeros can join the zeros at the start of the distance code
+  // lengths. The number of code length code lengths sent needs no search:
+  // each code length in the header is sent as itself at least once, since a
+  // repeat can not start a run of equal code lengths, so the symbols late in
+  // the order that are used can not be avoided.
+  static auto
+  plan_header(const std::array<PrefixCode, num_literal_length_symbols>
+                  &literal_length_prefix_codes,
+              const std::array<PrefixCode, num_distance_symbols>
+                  &distance_prefix_codes,
+              std::pmr::memory_resource &resource) -> Header {
 
     auto count_trailing_zero_length_prefix_codes = [](auto &prefix_codes) {
       std::uint16_t count = 0;
@@ -153,17 +633,6 @@ private:
       return std::max(min, std::uint16_t(max - trailing));
     };
 
-    constexpr auto min_leading_literal_length_prefix_codes = 257;
-    constexpr auto min_leading_distance_prefix_codes = 1;
-    constexpr auto min_leading_code_length_prefix_codes = 4;
-    constexpr auto literal_length_header_num_bits = 5;
-    constexpr auto distance_header_num_bits = 5;
-    constexpr auto code_length_header_num_bits = 4;
-    constexpr auto code_length_num_bits = 3;
-
-    constexpr std::uint8_t maximum_code_length = 7;
-    constexpr std::uint8_t num_code_length_symbols = 19;
-
     const auto num_leading_literal_length_prefix_codes =
         count_leading_nonzero_prefix_codes(
             min_leading_literal_length_prefix_codes, num_literal_length_symbols,
@@ -173,233 +642,304 @@ private:
         count_leading_nonzero_prefix_codes(
             min_leading_distance_prefix_codes, num_distance_symbols,
             count_trailing_zero_length_prefix_codes(distance_prefix_codes));
+    // The number of zero code lengths that start the distance code lengths,
+    // up to the minimum run of a repeat symbol.
+    std::uint16_t num_leading_zero_distance_code_lengths = 0;
+    while (num_leading_zero_distance_code_lengths < repeat_zero.min &&
+           num_leading_zero_distance_code_lengths <
+               num_leading_distance_prefix_codes &&
+           distance_prefix_codes.at(num_leading_zero_distance_code_lengths)
+                   .length == 0) {
+      num_leading_zero_distance_code_lengths++;
+    }
 
-    std::array<std::uint16_t, num_code_length_symbols>
-        count_by_code_length_symbol{};
-    std::vector<std::variant<std::uint8_t, CodeLengthSymbolWithOffset>>
-        cl_symbols;
-    std::uint8_t prev_prefix_code_length = maximum_prefix_code_length + 1;
-    std::uint16_t num_prev_prefix_code_length = 0;
-
-    auto add_code_length_symbol_batch =
-        [&prev_prefix_code_length, &num_prev_prefix_code_length, &cl_symbols,
-         &count_by_code_length_symbol](
-            CodeLengthSymbolBatch code_length_batch_symbol) {
-          while (num_prev_prefix_code_length >= code_length_batch_symbol.min) {
-            const std::uint16_t size = std::min(code_length_batch_symbol.max,
-                                                num_prev_prefix_code_length);
-            num_prev_prefix_code_length -= size;
-            count_by_code_length_symbol.at(code_length_batch_symbol.symbol)++;
-            cl_symbols.emplace_back(CodeLengthSymbolWithOffset{
-                .symbol = code_length_batch_symbol.symbol,
-                .offset = CodeLengthOffset{
-                    .bits = std::uint8_t(size - code_length_batch_symbol.min),
-                    .num_bits = code_length_batch_symbol.offset_num_bits}});
-          }
-          for (auto i = 0; std::cmp_less(i, num_prev_prefix_code_length); ++i) {
-            cl_symbols.emplace_back(prev_prefix_code_length);
-          }
-          count_by_code_length_symbol.at(prev_prefix_code_length) +=
-              num_prev_prefix_code_length;
-          num_prev_prefix_code_length = 0;
+    // The code lengths in the order they are sent.
+    std::array<std::uint8_t, maximum_num_code_lengths> sent_code_lengths{};
+    auto gather_code_lengths =
+        [&](std::uint16_t num_literal_length_code_lengths) {
+          const auto length = [](const PrefixCode &prefix_code) {
+            return prefix_code.length;
+          };
+          auto end = std::transform(literal_length_prefix_codes.begin(),
+                                    literal_length_prefix_codes.begin() +
+                                        num_literal_length_code_lengths,
+                                    sent_code_lengths.begin(), length);
+          end = std::transform(distance_prefix_codes.begin(),
+                               distance_prefix_codes.begin() +
+                                   num_leading_distance_prefix_codes,
+                               end, length);
+          return std::span<const std::uint8_t>(sent_code_lengths.begin(), end);
         };
 
-    auto add_consecutive_prefix_codes_to_code_length_symbols =
-        [&prev_prefix_code_length, &num_prev_prefix_code_length, &cl_symbols,
-         &count_by_code_length_symbol, &add_code_length_symbol_batch]() {
-          if (num_prev_prefix_code_length <= 0) {
-            return;
-          }
-
-          constexpr auto zero_11_or_more_times = CodeLengthSymbolBatch{
-              .symbol = 18, .offset_num_bits = 7, .min = 11, .max = 138};
-          if (prev_prefix_code_length == 0 &&
-              num_prev_prefix_code_length >= zero_11_or_more_times.min) {
-            add_code_length_symbol_batch(zero_11_or_more_times);
-            return;
-          }
-
-          constexpr auto zero_3_or_more_times = CodeLengthSymbolBatch{
-              .symbol = 17, .offset_num_bits = 3, .min = 3, .max = 10};
-          if (prev_prefix_code_length == 0 &&
-              num_prev_prefix_code_length >= zero_3_or_more_times.min) {
-            add_code_length_symbol_batch(zero_3_or_more_times);
-            return;
-          }
-
-          constexpr auto previous_3_or_more_times = CodeLengthSymbolBatch{
-              .symbol = 16, .offset_num_bits = 2, .min = 3, .max = 6};
-          cl_symbols.emplace_back(prev_prefix_code_length);
-          count_by_code_length_symbol.at(prev_prefix_code_length)++;
-          num_prev_prefix_code_length--;
-          if (num_prev_prefix_code_length > 0) {
-            add_code_length_symbol_batch(previous_3_or_more_times);
+    HeaderCandidate best{};
+    best.num_leading_literal_length_prefix_codes =
+        num_leading_literal_length_prefix_codes;
+    best.num_runs = greedy_code_length_runs(
+        gather_code_lengths(num_leading_literal_length_prefix_codes),
+        best.runs);
+    evaluate_header(best);
+
+    HeaderCandidate candidate{};
+    auto is_smaller_candidate =
+        [&](std::uint16_t num_literal_length_code_lengths,
+            const std::array<std::uint16_t, num_code_length_symbols> &bits) {
+          candidate.num_leading_literal_length_prefix_codes =
+              num_literal_length_code_lengths;
+          candidate.num_runs = optimal_code_length_runs(
+              gather_code_lengths(num_literal_length_code_lengths), bits,
+              candidate.runs);
+          evaluate_header(candidate);
+          if (candidate.bits >= best.bits) {
+            return false;
           }
+          best = candidate;
+          return true;
         };
 
-    auto add_prefix_codes_to_code_length_symbols =
-        [&prev_prefix_code_length, &num_prev_prefix_code_length,
-         &add_consecutive_prefix_codes_to_code_length_symbols](const auto start,
-                                                               const auto end) {
-          for (auto prefix_code_ptr = start; prefix_code_ptr < end;
-               ++prefix_code_ptr) {
-            const auto prefix_code_length = prefix_code_ptr->length;
-            if (prefix_code_length == prev_prefix_code_length) {
-              num_prev_prefix_code_length++;
-            } else {
-              add_consecutive_prefix_codes_to_code_length_symbols();
-              prev_prefix_code_length = prefix_code_length;
-              num_prev_prefix_code_length = 1;
-            }
-          }
-        };
+    for (int round = 0; round < maximum_header_rounds; ++round) {
+      const auto code_length_lengths = best.code_length_lengths;
+      if (!is_smaller_candidate(num_leading_literal_length_prefix_codes,
+                                symbol_bits(best)) ||
+          best.code_length_lengths == code_length_lengths) {
+        break;
+      }
+    }
+    // Zero literal/length code lengths sent past the last nonzero one can
+    // only pay for themselves by making a run of zeros long enough for a
+    // repeat symbol.
+    if (num_leading_zero_distance_code_lengths > 0 &&
+        num_leading_zero_distance_code_lengths < repeat_zero.min) {
+      const std::uint16_t num_literal_length_code_lengths =
+          num_leading_literal_length_prefix_codes + repeat_zero.min -
+          num_leading_zero_distance_code_lengths;
+      if (num_literal_length_code_lengths <=
+          max_leading_literal_length_prefix_codes) {
+        is_smaller_candidate(num_literal_length_code_lengths,
+                             symbol_bits(best));
+      }
+    }
 
-    add_prefix_codes_to_code_length_symbols(
-        literal_length_prefix_codes.begin(),
-        literal_length_prefix_codes.begin() +
-            num_leading_literal_length_prefix_codes);
-    add_prefix_codes_to_code_length_symbols(
-        distance_prefix_codes.begin(),
-        distance_prefix_codes.begin() + num_leading_distance_prefix_codes);
-    add_consecutive_prefix_codes_to_code_length_symbols();
-
-    const auto code_length_lengths =
-        package_merge(std::span<std::uint16_t, num_code_length_symbols>(
-                          count_by_code_length_symbol.begin(),
-                          count_by_code_length_symbol.end()),
-                      maximum_code_length);
+    std::pmr::vector<std::variant<std::uint8_t, CodeLengthSymbolWithOffset>>
+        cl_symbols(&resource);
+    cl_symbols.reserve(best.num_runs);
+    for (std::size_t i = 0; i < best.num_runs; ++i) {
+      const auto run = best.runs.at(i);
+      if (run.symbol < repeat_previous.symbol) {
+        cl_symbols.emplace_back(run.symbol);
+      } else {
+        cl_symbols.emplace_back(CodeLengthSymbolWithOffset{
+            .symbol = run.symbol,
+            .offset = CodeLengthOffset{.bits = extra_bits(run),
+                                       .num_bits = num_extra_bits(
+                                           run.symbol)}});
+      }
+    }
     const auto code_length_prefix_codes =
         prefix_codes(std::span<const std::uint8_t, num_code_length_symbols>(
-            code_length_lengths));
-    const auto reordered_code_length_prefix_codes =
-        std::array<PrefixCode, num_code_length_symbols>{
-            code_length_prefix_codes[16], code_length_prefix_codes[17],
-            code_length_prefix_codes[18], code_length_prefix_codes[0],
-            code_length_prefix_codes[8],  code_length_prefix_codes[7],
-            code_length_prefix_codes[9],  code_length_prefix_codes[6],
-            code_length_prefix_codes[10], code_length_prefix_codes[5],
-            code_length_prefix_codes[11], code_length_prefix_codes[4],
-            code_length_prefix_codes[12], code_length_prefix_codes[3],
-            code_length_prefix_codes[13], code_length_prefix_codes[2],
-            code_length_prefix_codes[14], code_length_prefix_codes[1],
-            code_length_prefix_codes[15]};
-    const auto num_leading_code_length_prefix_codes =
-        count_leading_nonzero_prefix_codes(
-            min_leading_code_length_prefix_codes, num_code_length_symbols,
-            count_trailing_zero_length_prefix_codes(
-                reordered_code_length_prefix_codes));
+            best.code_length_lengths));
+    std::array<PrefixCode, num_code_length_symbols>
+        reordered_code_length_prefix_codes{};
+    for (std::size_t i = 0; i < num_code_length_symbols; ++i) {
+      reordered_code_length_prefix_codes.at(i) =
+          code_length_prefix_codes.at(code_length_order.at(i));
+    }
 
-    buffered_out_.push_bits(num_leading_literal_length_prefix_codes -
-                                min_leading_literal_length_prefix_codes,
-                            literal_length_header_num_bits);
-    buffered_out_.push_bits(num_leading_distance_prefix_codes -
-                                min_leading_distance_prefix_codes,
-                            distance_header_num_bits);
-    buffered_out_.push_bits(num_leading_code_length_prefix_codes -
-                                min_leading_code_length_prefix_codes,
-                            code_length_header_num_bits);
+    return Header{
+        .num_leading_literal_length_prefix_codes =
+            best.num_leading_literal_length_prefix_codes,
+        .num_leading_distance_prefix_codes = num_leading_distance_prefix_codes,
+        .num_leading_code_length_prefix_codes =
+            best.num_leading_code_length_prefix_codes,
+        .code_length_prefix_codes = code_length_prefix_codes,
+        .reordered_code_length_prefix_codes =
+            reordered_code_length_prefix_codes,
+        .cl_symbols = std::move(cl_symbols)};
+  }
 
-    for (std::uint8_t i = 0; i < num_leading_code_length_prefix_codes; ++i) {
-      buffered_out_.push_bits(reordered_code_length_prefix_codes.at(i).length,
-                              code_length_num_bits);
+  auto push_header(const Header &header) {
+    out_.push_bits(header.num_leading_literal_length_prefix_codes -
+                       min_leading_literal_length_prefix_codes,
+                   literal_length_header_num_bits);
+    out_.push_bits(header.num_leading_distance_prefix_codes -
+                       min_leading_distance_prefix_codes,
+                   distance_header_num_bits);
+    out_.push_bits(header.num_leading_code_length_prefix_codes -
+                       min_leading_code_length_prefix_codes,
+                   code_length_header_num_bits);
+
+    for (std::uint8_t i = 0; i < header.num_leading_code_length_prefix_codes;
+         ++i) {
+      out_.push_bits(header.reordered_code_length_prefix_codes.at(i).length,
+                     code_length_num_bits);
     }
 
-    for (const auto &symbol_or_symbol_with_offset : cl_symbols) {
+    for (const auto &symbol_or_symbol_with_offset : header.cl_symbols) {
       if (std::holds_alternative<CodeLengthSymbolWithOffset>(
               symbol_or_symbol_with_offset)) {
         const CodeLengthSymbolWithOffset &symbol_with_offset =
             std::get<CodeLengthSymbolWithOffset>(symbol_or_symbol_with_offset);
-        buffered_out_.push_prefix_code(
-            code_length_prefix_codes.at(symbol_with_offset.symbol));
-        buffered_out_.push_bits(symbol_with_offset.offset.bits,
-                                symbol_with_offset.offset.num_bits);
+        out_.push_prefix_code(
+            header.code_length_prefix_codes.at(symbol_with_offset.symbol));
+        out_.push_bits(symbol_with_offset.offset.bits,
+                       symbol_with_offset.offset.num_bits);
       } else {
         const std::uint8_t symbol =
             std::get<std::uint8_t>(symbol_or_symbol_with_offset);
-        buffered_out_.push_prefix_code(code_length_prefix_codes.at(symbol));
+        out_.push_prefix_code(header.code_length_prefix_codes.at(symbol));
       }
     }
   }
 
-  auto flush_block() {
-    const auto literal_length_prefix_code_lengths = package_merge(
-        std::span<std::size_t, num_literal_length_symbols>(
-            count_by_symbol_.begin(),
-            count_by_symbol_.begin() + num_literal_length_symbols),
-        maximum_prefix_code_length);
-    const auto distance_prefix_code_lengths =
-        package_merge(std::span<std::size_t, num_distance_symbols>(
-                          count_by_symbol_.begin() + num_literal_length_symbols,
-                          count_by_symbol_.end()),
-                      maximum_prefix_code_length);
-    const auto literal_length_prefix_codes =
-        prefix_codes(std::span<const std::uint8_t, num_literal_length_symbols>(
-            literal_length_prefix_code_lengths));
-    const auto distance_prefix_codes =
-        prefix_codes(std::span<const std::uint8_t, num_distance_symbols>(
-            distance_prefix_code_lengths));
-    flush_block_metadata(literal_length_prefix_codes, distance_prefix_codes);
-    auto it = block_.begin();
-    while (it != block_.end()) {
-      auto symbol = std::get<std::uint16_t>(*it++);
-      if (symbol > eob_symbol) {
-        // Is a back reference.
-        auto length_prefix_code = literal_length_prefix_codes.at(symbol);
-        auto length_offset = std::get<Offset>(*it++);
-        auto distance_prefix_code = distance_prefix_codes.at(
-            std::get<std::uint16_t>(*it++) - num_literal_length_symbols);
-        auto distance_offset = std::get<Offset>(*it++);
-        const auto num_back_reference_bits =
-            (length_prefix_code.length + length_offset.num_bits +
-             distance_prefix_code.length + distance_offset.num_bits);
-
-        const auto length = SymbolWithOffset::to_length(
-            {.symbol = symbol, .offset = length_offset});
-        auto num_literal_bits = 0;
-        for (auto literal_it = it; literal_it != it + length; ++literal_it) {
-          const auto &prefix_code = literal_length_prefix_codes.at(
-              std::get<std::uint16_t>(*literal_it));
-          if (prefix_code.length == 0) {
-            // At least one literal does not have a prefix code, so we must use
-            // the back reference. Since in cases of ties we prefer the back
-            // reference, set the number of literal bits to the number of back
-            // reference bits.
-            num_literal_bits = num_back_reference_bits;
-            break;
-          }
-          num_literal_bits += prefix_code.length;
-        }
-        if (num_literal_bits < num_back_reference_bits) {
-          // The literals are more efficient than the back reference, so we use
-          // the literals.
-          for (auto i = 0; std::cmp_less(i, length); ++i) {
-            buffered_out_.push_prefix_code(
-                literal_length_prefix_codes.at(std::get<std::uint16_t>(*it++)));
-          }
-        } else {
-          // The back reference is more efficient than the literals, so we use
-          // the back reference.
-          buffered_out_.push_prefix_code(length_prefix_code);
-          buffered_out_.push_offset(length_offset);
-          buffered_out_.push_prefix_code(distance_prefix_code);
-          buffered_out_.push_offset(distance_offset);
-          it += length;
-        }
-      } else {
+  // Visit the tokens of a planned block with the code words they are encoded
+  // with, choosing between each back reference and its literals, and passing
+  // the symbols of each token along with its code words. The offsets of a
+  // back reference are fused into the code words of its length and distance.
+  // The same choices are made when sizing and when encoding the block, so the
+  // planned size is exact.
+  auto visit_tokens(const PlannedBlock &planned_block, auto &&on_literal,
+                    auto &&on_back_reference) const {
+    const auto &literal_length_code_words =
+        planned_block.literal_length_code_words;
+    const auto &distance_code_words = planned_block.distance_code_words;
+    auto byte = bytes_.begin() +
+                static_cast<std::ptrdiff_t>(planned_block.begin.byte);
+    for (auto token_index = planned_block.begin.token;
+         token_index != planned_block.end.token; ++token_index) {
+      const auto token = block_[token_index];
+      if ((token & is_back_reference_bit) == 0) {
         // Is a literal.
-        buffered_out_.push_prefix_code(literal_length_prefix_codes.at(symbol));
+        on_literal(literal_length_code_words.at(token),
+                   static_cast<std::uint8_t>(token));
+        ++byte;
+        continue;
+      }
+
+      // Is a back reference.
+      const std::uint16_t length =
+          (token & token_length_mask) + minimum_back_reference_length;
+      const std::uint16_t distance =
+          ((token >> token_distance_shift) & token_distance_mask) + 1;
+      const auto distance_symbol_with_offset =
+          SymbolWithOffset::from_distance(distance);
+      const auto &distance_code_word =
+          distance_code_words.at(distance_symbol_with_offset.symbol);
+      const auto literals = std::span(byte, length);
+      const auto back_reference_length =
+          num_reparse_passes_ == 0
+              ? back_reference_or_literals(literal_length_code_words,
+                                           distance_code_word.with_offset(
+                                               distance_symbol_with_offset
+                                                   .offset),
+                                           literals)
+              : cheapest_back_reference_length(
+                    literal_length_code_words, distance_code_word,
+                    distance_symbol_with_offset.offset, literals);
+
+      if (back_reference_length > 0) {
+        const auto &length_symbol_with_offset =
+            SymbolWithOffset::from_length(back_reference_length);
+        on_back_reference(
+            literal_length_code_words.at(length_symbol_with_offset.symbol)
+                .with_offset(length_symbol_with_offset.offset),
+            distance_code_word.with_offset(distance_symbol_with_offset.offset),
+            length_symbol_with_offset.symbol,
+            distance_symbol_with_offset.symbol);
+      }
+      for (const auto literal : literals.subspan(back_reference_length)) {
+        on_literal(literal_length_code_words.at(literal), literal);
+      }
+      byte += length;
+    }
+  }
+
+  // Return the length of a back reference if it is no larger than its
+  // literals, or zero if its literals are smaller.
+  static auto back_reference_or_literals(
+      const std::array<CodeWord, num_literal_length_symbols>
+          &literal_length_code_words,
+      const CodeWord &distance_code_word,
+      std::span<const std::uint8_t> literals) -> std::uint16_t {
+    const auto length = static_cast<std::uint16_t>(literals.size());
+    const auto &length_symbol_with_offset =
+        SymbolWithOffset::from_length(length);
+    const auto num_back_reference_bits =
+        literal_length_code_words.at(length_symbol_with_offset.symbol)
+            .with_offset(length_symbol_with_offset.offset)
+            .length +
+        distance_code_word.length;
+
+    auto num_literal_bits = 0;
+    for (const auto literal : literals) {
+      const auto &code_word = literal_length_code_words.at(literal);
+      if (code_word.length == 0) {
+        // At least one literal does not have a prefix code, so we must use
+        // the back reference.
+        return length;
+      }
+      num_literal_bits += code_word.length;
+    }
+    // In cases of ties we prefer the back reference.
+    return num_literal_bits < num_back_reference_bits ? 0 : length;
+  }
+
+  // Return the length of the prefix of a back reference that, followed by
+  // the rest of its bytes as literals, has the fewest bits, or zero if all of
+  // its bytes are fewest as literals. A back reference that is short or far
+  // away is dropped, and one whose length falls just past the start of a
+  // length symbol may be shortened to save the extra bits. Options whose
+  // symbols have no prefix code are skipped; the option chosen in the
+  // previous pass always has one, since the codes were built from its counts.
+  // In cases of ties the longest back reference is preferred.
+  static auto cheapest_back_reference_length(
+      const std::array<CodeWord, num_literal_length_symbols>
+          &literal_length_code_words,
+      const CodeWord &distance_code_word, Offset distance_offset,
+      std::span<const std::uint8_t> literals) -> std::uint16_t {
+    const auto length = static_cast<std::uint16_t>(literals.size());
+    std::uint16_t cheapest_length = length;
+    auto cheapest_bits = std::numeric_limits<std::uint32_t>::max();
+    // The bits of the literals after the prefix.
+    std::uint32_t num_literal_bits = 0;
+    for (auto prefix_length = length; prefix_length > 0; --prefix_length) {
+      if (prefix_length >= minimum_back_reference_length &&
+          distance_code_word.length > 0) {
+        const auto &length_symbol_with_offset =
+            SymbolWithOffset::from_length(prefix_length);
+        const auto &length_code_word =
+            literal_length_code_words.at(length_symbol_with_offset.symbol);
+        const std::uint32_t num_bits =
+            length_code_word.length +
+            length_symbol_with_offset.offset.num_bits +
+            distance_code_word.length + distance_offset.num_bits +
+            num_literal_bits;
+        if (length_code_word.length > 0 && num_bits < cheapest_bits) {
+          cheapest_length = prefix_length;
+          cheapest_bits = num_bits;
+        }
       }
+      const auto &code_word =
+          literal_length_code_words.at(literals[prefix_length - 1]);
+      if (code_word.length == 0) {
+        return cheapest_length;
+      }
+      num_literal_bits += code_word.length;
     }
+    return num_literal_bits < cheapest_bits ? 0 : cheapest_length;
   }
 
   auto step() {
-    if (lzss_.back_reference().length >= minimum_back_reference_length) {
+    if (split_blocks_ && num_tokens_since_candidate_boundary_ ==
+                             num_tokens_between_candidate_boundaries) {
+      add_candidate_boundary();
+    }
+    num_tokens_since_candidate_boundary_++;
+    if (tokenizer_.back_reference().length >= minimum_back_reference_length) {
       push_back_reference();
-      lzss_.take_back_reference();
+      tokenizer_.take_back_reference();
       return;
     }
-    push_symbol(lzss_.literal());
-    lzss_.take_literal();
+    push_literal(tokenizer_.literal());
+    tokenizer_.take_literal();
   }
 };
 
@@ -1,13 +1,24 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <bit>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <numbers>
+#include <utility>
 #include <vector>
 
+#include "histogram.hpp"
 #include "size.hpp"
 
+struct CusumDistributionDetectorParams {
+  int warmup;
+  // Threshold on the cumulative log-likelihood ratio, in nats.
+  double threshold;
+};
+
 // References:
 // https://staff.math.su.se/hoehle/pubs/hoehle2010-preprint.pdf
 // https://sarem-seitz.com/posts/probabilistic-cusum-for-change-point-detection.html
@@ -15,11 +26,6 @@
 template <std::size_t N = (1U << size_of_in_bits<std::uint8_t>())>
 class CusumDistributionDetector {
 public:
-  struct CusumDistributionDetectorParams {
-    int warmup;
-    double threshold;
-  };
-
   explicit CusumDistributionDetector(CusumDistributionDetectorParams params)
       : warmup_steps_(params.warmup), threshold_(params.threshold) {}
 
@@ -27,10 +33,11 @@ public:
     current_step_ = 0;
     current_counts_total_ = 0;
     cusum_ = 0.0;
+    steps_since_cusum_minimum_ = 0;
 
-    std::ranges::fill(baseline_counts_, 0.0);
+    warmup_counts_.reset();
     std::ranges::fill(baseline_probs_, 0.0);
-    std::ranges::fill(current_counts_, 0.0);
+    current_counts_.fill(0);
   }
 
   auto step(int y) -> bool {
@@ -50,6 +57,7 @@ public:
       const bool is_changepoint = cusum_ > threshold_;
 
       if (is_changepoint) {
+        change_point_lag_ = steps_since_cusum_minimum_;
         reset();
       }
 
@@ -59,6 +67,15 @@ public:
     return false;
   }
 
+  // Return the number of most recent steps (including the step that reported
+  // the last change point) that are estimated to follow the change. The
+  // estimate is the last step at which the cumulative sum was at its minimum
+  // of zero, since the log-likelihood ratios only accumulate once the
+  // distribution has shifted.
+  [[nodiscard]] auto change_point_lag() const -> std::size_t {
+    return change_point_lag_;
+  }
+
 private:
   int warmup_steps_;
   double threshold_;
@@ -66,15 +83,24 @@ private:
   int current_step_{0};
   int current_counts_total_{0};
   double cusum_{0.0};
+  std::size_t steps_since_cusum_minimum_{0};
+  std::size_t change_point_lag_{0};
 
-  std::vector<double> baseline_counts_ = std::vector<double>(N);
+  // Counts during the warmup are only read once the warmup ends, so they are
+  // kept in a histogram with interleaved count tables. Counts after the warmup
+  // are read on every step, so they are kept in a single table.
+  Histogram<N> warmup_counts_;
   std::vector<double> baseline_probs_ = std::vector<double>(N);
 
-  std::vector<double> current_counts_ = std::vector<double>(N);
+  std::array<std::uint32_t, N> current_counts_{};
 
   auto update_counters(int y) -> void {
     current_step_++;
-    current_counts_[y] += 1.0;
+    if (current_step_ <= warmup_steps_) {
+      warmup_counts_.add(y);
+    } else {
+      current_counts_[y]++;
+    }
     current_counts_total_++;
   }
 
@@ -83,10 +109,10 @@ private:
       return;
     }
 
-    baseline_counts_.swap(current_counts_);
+    const auto baseline_counts = warmup_counts_.counts();
 
     for (int i = 0; i < N; ++i) {
-      const auto count = baseline_counts_[i];
+      const double count = baseline_counts[i];
       baseline_probs_[i] = count > 0 ? count / current_counts_total_ : 1.0 / N;
     }
 
@@ -94,10 +120,197 @@ private:
   }
 
   auto update_cusum(int y) -> void {
-    const auto count = current_counts_[y];
+    const double count = current_counts_[y];
     const double p1_y = count > 0 ? count / current_counts_total_ : 1.0 / N;
     const double p0_y = baseline_probs_[y];
     const double llr_t = std::log(p1_y) - std::log(p0_y);
     cusum_ = std::max(0.0, cusum_ + llr_t);
+    steps_since_cusum_minimum_ =
+        cusum_ > 0.0 ? steps_since_cusum_minimum_ + 1 : 0;
+  }
+};
+
+namespace detail {
+
+// Number of fractional bits in fixed-point base-2 logarithms.
+constexpr std::uint8_t log2_fraction_bits = 16;
+// Number of leading mantissa bits used to index the logarithm table.
+constexpr std::uint8_t log2_table_bits = 10;
+
+// Compute log2(1 + i / 2^log2_table_bits) in fixed point for each i, using
+// the bit-by-bit squaring method so that the table can be built at compile
+// time.
+constexpr auto get_log2_mantissa_table()
+    -> std::array<std::int32_t, (1U << log2_table_bits) + 1> {
+  constexpr std::uint8_t y_fraction_bits = 30;
+  constexpr std::uint64_t one = 1ULL << y_fraction_bits;
+  std::array<std::int32_t, (1U << log2_table_bits) + 1> table{};
+  for (std::uint32_t i = 0; i < table.size(); ++i) {
+    std::uint64_t y = one + ((std::uint64_t{i} << y_fraction_bits) >>
+                             log2_table_bits);
+    if (y >= 2 * one) {
+      table.at(i) = 1 << log2_fraction_bits;
+      continue;
+    }
+    // Compute one extra bit to round to nearest.
+    std::uint32_t log2_y = 0;
+    for (auto bit = 0; bit <= log2_fraction_bits; ++bit) {
+      y = (y * y) >> y_fraction_bits;
+      log2_y <<= 1U;
+      if (y >= 2 * one) {
+        y >>= 1U;
+        log2_y |= 1U;
+      }
+    }
+    table.at(i) = static_cast<std::int32_t>((log2_y + 1) >> 1U);
+  }
+  return table;
+}
+
+constexpr std::array<std::int32_t, (1U << log2_table_bits) + 1>
+    log2_mantissa_table{get_log2_mantissa_table()};
+
+// fixed_log2 computes log2(x) for x > 0 with log2_fraction_bits fractional
+// bits: the integer part comes from the position of the leading bit, and the
+// fractional part from the mantissa table, linearly interpolated on the bits
+// below the table index.
+constexpr auto fixed_log2(std::uint32_t x) -> std::int32_t {
+  const auto leading_bit = static_cast<std::uint8_t>(std::bit_width(x) - 1);
+  const auto integer_part =
+      static_cast<std::int32_t>(leading_bit) << log2_fraction_bits;
+  if (leading_bit <= log2_table_bits) {
+    const auto index = (x << (log2_table_bits - leading_bit)) &
+                       ((1U << log2_table_bits) - 1);
+    return integer_part + log2_mantissa_table[index];
+  }
+  const auto num_remainder_bits =
+      static_cast<std::uint8_t>(leading_bit - log2_table_bits);
+  const auto index =
+      (x >> num_remainder_bits) & ((1U << log2_table_bits) - 1);
+  const auto remainder = x & ((1U << num_remainder_bits) - 1);
+  const auto delta =
+      log2_mantissa_table[index + 1] - log2_mantissa_table[index];
+  return integer_part + log2_mantissa_table[index] +
+         static_cast<std::int32_t>(
+             (static_cast<std::int64_t>(delta) * remainder) >>
+             num_remainder_bits);
+}
+
+} // namespace detail
+
+// FixedPointCusumDistributionDetector follows the same algorithm as
+// CusumDistributionDetector, but computes log-likelihood ratios from integer
+// counts using fixed-point base-2 logarithms, and accumulates the cumulative
+// sum in integers. This avoids two calls to std::log per step. Change points
+// agree with CusumDistributionDetector up to rounding of the logarithms.
+template <std::size_t N = (1U << size_of_in_bits<std::uint8_t>())>
+class FixedPointCusumDistributionDetector {
+public:
+  explicit FixedPointCusumDistributionDetector(
+      CusumDistributionDetectorParams params)
+      : warmup_steps_(params.warmup),
+        threshold_(static_cast<std::int64_t>(
+            params.threshold / std::numbers::ln2 *
+            (1U << detail::log2_fraction_bits))) {}
+
+  auto reset() -> void {
+    current_step_ = 0;
+    current_counts_total_ = 0;
+    cusum_ = 0;
+    steps_since_cusum_minimum_ = 0;
+
+    warmup_counts_.reset();
+    current_counts_.fill(0);
+  }
+
+  auto step(int y) -> bool {
+    if (y < 0 || std::cmp_greater_equal(y, N)) {
+      return false;
+    }
+
+    update_counters(y);
+
+    if (current_step_ == warmup_steps_) {
+      init_params();
+    }
+
+    if (current_step_ >= warmup_steps_) {
+      update_cusum(y);
+
+      const bool is_changepoint = cusum_ > threshold_;
+
+      if (is_changepoint) {
+        change_point_lag_ = steps_since_cusum_minimum_;
+        reset();
+      }
+
+      return is_changepoint;
+    }
+
+    return false;
+  }
+
+  // See CusumDistributionDetector::change_point_lag.
+  [[nodiscard]] auto change_point_lag() const -> std::size_t {
+    return change_point_lag_;
+  }
+
+private:
+  // log2(1 / N), the log-probability of a symbol that has not been seen.
+  static constexpr std::int32_t log2_unseen_prob =
+      -detail::fixed_log2(static_cast<std::uint32_t>(N));
+
+  int warmup_steps_;
+  std::int64_t threshold_;
+
+  int current_step_{0};
+  std::uint32_t current_counts_total_{0};
+  std::int64_t cusum_{0};
+  std::size_t steps_since_cusum_minimum_{0};
+  std::size_t change_point_lag_{0};
+
+  Histogram<N> warmup_counts_;
+  std::array<std::int32_t, N> baseline_log2_probs_{};
+
+  std::array<std::uint32_t, N> current_counts_{};
+
+  auto update_counters(int y) -> void {
+    current_step_++;
+    if (current_step_ <= warmup_steps_) {
+      warmup_counts_.add(y);
+    } else {
+      current_counts_[y]++;
+    }
+    current_counts_total_++;
+  }
+
+  auto init_params() -> void {
+    if (current_counts_total_ == 0) {
+      return;
+    }
+
+    const auto baseline_counts = warmup_counts_.counts();
+    const auto log2_total = detail::fixed_log2(current_counts_total_);
+
+    for (std::size_t i = 0; i < N; ++i) {
+      const auto count = baseline_counts[i];
+      baseline_log2_probs_[i] =
+          count > 0 ? detail::fixed_log2(count) - log2_total
+                    : log2_unseen_prob;
+    }
+
+    current_counts_total_ = 0;
+  }
+
+  auto update_cusum(int y) -> void {
+    const auto count = current_counts_[y];
+    const std::int32_t log2_p1_y =
+        count > 0 ? detail::fixed_log2(count) -
+                        detail::fixed_log2(current_counts_total_)
+                  : log2_unseen_prob;
+    const std::int32_t llr_t = log2_p1_y - baseline_log2_probs_[y];
+    cusum_ = std::max<std::int64_t>(0, cusum_ + llr_t);
+    steps_since_cusum_minimum_ =
+        cusum_ > 0 ? steps_since_cusum_minimum_ + 1 : 0;
   }
 };
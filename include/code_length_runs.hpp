@@ -0,0 +1,284 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "constants.hpp"
+
+// The code lengths of the prefix codes of a dynamic block are sent as a
+// sequence of code length symbols: symbols 0-15 send a single code length,
+// and the repeat symbols 16-18 send a run of code lengths, with the length of
+// the run in their extra bits. Runs may cross from the literal/length code
+// lengths into the distance code lengths.
+constexpr std::uint8_t num_code_length_symbols = 19;
+
+// The maximum number of code lengths sent in a header.
+constexpr std::size_t maximum_num_code_lengths =
+    num_literal_length_symbols + num_distance_symbols;
+
+// A code length symbol and the number of code lengths it sends.
+struct CodeLengthRun {
+  std::uint8_t symbol;
+  std::uint8_t length;
+};
+
+// A repeat symbol, which sends between min and max code lengths.
+struct RepeatSymbol {
+  std::uint8_t symbol;
+  std::uint8_t num_extra_bits;
+  std::uint8_t min;
+  std::uint8_t max;
+};
+
+// Repeat the previous code length 3-6 times.
+constexpr RepeatSymbol repeat_previous{
+    .symbol = 16, .num_extra_bits = 2, .min = 3, .max = 6};
+// Repeat a zero code length 3-10 times.
+constexpr RepeatSymbol repeat_zero{
+    .symbol = 17, .num_extra_bits = 3, .min = 3, .max = 10};
+// Repeat a zero code length 11-138 times.
+constexpr RepeatSymbol repeat_zero_long{
+    .symbol = 18, .num_extra_bits = 7, .min = 11, .max = 138};
+
+// The number of extra bits sent after a code length symbol.
+constexpr auto num_extra_bits(std::uint8_t symbol) -> std::uint8_t {
+  switch (symbol) {
+  case repeat_previous.symbol:
+    return repeat_previous.num_extra_bits;
+  case repeat_zero.symbol:
+    return repeat_zero.num_extra_bits;
+  case repeat_zero_long.symbol:
+    return repeat_zero_long.num_extra_bits;
+  default:
+    return 0;
+  }
+}
+
+// The value of the extra bits sent after the symbol of a run.
+constexpr auto extra_bits(CodeLengthRun run) -> std::uint8_t {
+  switch (run.symbol) {
+  case repeat_previous.symbol:
+    return run.length - repeat_previous.min;
+  case repeat_zero.symbol:
+    return run.length - repeat_zero.min;
+  case repeat_zero_long.symbol:
+    return run.length - repeat_zero_long.min;
+  default:
+    return 0;
+  }
+}
+
+// Split code lengths into runs greedily: a run of zeros is sent with the
+// longest repeat symbol that fits, and a run of any other length is sent as
+// the length followed by repeats of the previous length. Lengths left over
+// from a run are sent singly. Return the number of runs, which are written
+// to runs; runs needs room for one run per code length.
+inline auto greedy_code_length_runs(std::span<const std::uint8_t> code_lengths,
+                                    std::span<CodeLengthRun> runs)
+    -> std::size_t {
+  std::size_t num_runs = 0;
+  auto add_runs = [&runs, &num_runs](RepeatSymbol repeat, std::uint8_t length,
+                                     std::size_t count) {
+    while (count >= repeat.min) {
+      const auto size = std::min<std::size_t>(repeat.max, count);
+      runs[num_runs++] = CodeLengthRun{
+          .symbol = repeat.symbol, .length = static_cast<std::uint8_t>(size)};
+      count -= size;
+    }
+    for (; count > 0; --count) {
+      runs[num_runs++] = CodeLengthRun{.symbol = length, .length = 1};
+    }
+  };
+  for (std::size_t begin = 0; begin < code_lengths.size();) {
+    const auto length = code_lengths[begin];
+    auto end = begin + 1;
+    while (end < code_lengths.size() && code_lengths[end] == length) {
+      ++end;
+    }
+    const auto count = end - begin;
+    if (length == 0 && count >= repeat_zero_long.min) {
+      add_runs(repeat_zero_long, length, count);
+    } else if (length == 0 && count >= repeat_zero.min) {
+      add_runs(repeat_zero, length, count);
+    } else {
+      runs[num_runs++] = CodeLengthRun{.symbol = length, .length = 1};
+      add_runs(repeat_previous, length, count - 1);
+    }
+    begin = end;
+  }
+  return num_runs;
+}
+
+namespace detail {
+
+// The positions of a sliding window over values, in order of increasing
+// value, so that the position of the smallest value in the window is at the
+// front. Each position is pushed and popped at most once.
+template <std::size_t Capacity> struct SlidingMinimum {
+  std::array<std::uint16_t, Capacity> positions;
+  std::size_t front = 0;
+  std::size_t back = 0;
+
+  // Add a position to the back of the window, dropping the positions whose
+  // values are no smaller, as they can no longer be the smallest.
+  auto push(std::uint16_t position, std::span<const std::uint32_t> values) {
+    while (back > front && values[positions[back - 1]] >= values[position]) {
+      --back;
+    }
+    positions[back++] = position;
+  }
+
+  // Drop the positions before first from the front of the window.
+  auto pop_before(std::size_t first) {
+    while (positions[front] < first) {
+      ++front;
+    }
+  }
+};
+
+} // namespace detail
+
+// Split code lengths into the runs with the fewest bits, given the bits of
+// the code of each code length symbol (the extra bits are added here).
+// Unlike the greedy split, a run may be split anywhere, and a run of zeros
+// may also be sent as repeats of the previous zero. Return the number of
+// runs, which are written to runs; runs needs room for one run per code
+// length.
+//
+// No run crosses from one code length to another, so each stretch of equal
+// code lengths is split on its own. A stretch of another length is sent as
+// the length followed by repeats and single lengths, and only the fewest and
+// the most repeats that cover all of it but the single lengths need to be
+// considered. The split of a stretch of zeros depends only on its length, so
+// the splits of every length of stretch up to the longest are found once,
+// by dynamic programming. A repeat symbol costs the same whatever the length
+// of its run, so the cheapest run of a repeat symbol ending at each length
+// starts after the cheapest number of zeros in a sliding window, which is
+// kept in a monotone queue. This takes linear time.
+inline auto
+optimal_code_length_runs(std::span<const std::uint8_t> code_lengths,
+                         const std::array<std::uint16_t,
+                                          num_code_length_symbols> &symbol_bits,
+                         std::span<CodeLengthRun> runs) -> std::size_t {
+  // The bits of each symbol, including its extra bits.
+  std::array<std::uint32_t, num_code_length_symbols> run_bits_by_symbol{};
+  for (std::uint8_t symbol = 0; symbol < num_code_length_symbols; ++symbol) {
+    run_bits_by_symbol[symbol] = symbol_bits[symbol] + num_extra_bits(symbol);
+  }
+
+  std::size_t maximum_num_zeros = 0;
+  for (std::size_t begin = 0; begin < code_lengths.size();) {
+    auto end = begin + 1;
+    while (end < code_lengths.size() &&
+           code_lengths[end] == code_lengths[begin]) {
+      ++end;
+    }
+    if (code_lengths[begin] == 0) {
+      maximum_num_zeros = std::max(maximum_num_zeros, end - begin);
+    }
+    begin = end;
+  }
+
+  // The fewest bits to send a stretch of n zeros, and the last run of the
+  // split that achieves them.
+  std::array<std::uint32_t, maximum_num_code_lengths + 1> bits_by_num_zeros;
+  std::array<CodeLengthRun, maximum_num_code_lengths + 1> last_runs;
+  // For each repeat symbol, the numbers of zeros after which it could start
+  // a run ending at the current number of zeros.
+  constexpr std::array repeats{repeat_previous, repeat_zero, repeat_zero_long};
+  std::array<detail::SlidingMinimum<maximum_num_code_lengths + 1>,
+             repeats.size()>
+      starts_by_repeat{};
+  bits_by_num_zeros[0] = 0;
+  for (std::size_t end = 1; end <= maximum_num_zeros; ++end) {
+    auto bits = bits_by_num_zeros[end - 1] + run_bits_by_symbol[0];
+    auto last_run = CodeLengthRun{.symbol = 0, .length = 1};
+    for (std::size_t i = 0; i < repeats.size(); ++i) {
+      const auto &repeat = repeats[i];
+      // A repeat of the previous code length can not start a stretch, since
+      // the previous code length differs.
+      const std::size_t first_begin =
+          repeat.symbol == repeat_previous.symbol ? 1 : 0;
+      if (end < first_begin + repeat.min) {
+        continue;
+      }
+      auto &starts = starts_by_repeat[i];
+      starts.push(end - repeat.min, bits_by_num_zeros);
+      if (end > repeat.max) {
+        starts.pop_before(end - repeat.max);
+      }
+      const auto begin = starts.positions[starts.front];
+      const auto run_bits =
+          bits_by_num_zeros[begin] + run_bits_by_symbol[repeat.symbol];
+      if (run_bits < bits) {
+        bits = run_bits;
+        last_run = CodeLengthRun{
+            .symbol = repeat.symbol,
+            .length = static_cast<std::uint8_t>(end - begin)};
+      }
+    }
+    bits_by_num_zeros[end] = bits;
+    last_runs[end] = last_run;
+  }
+
+  std::size_t num_runs = 0;
+  for (std::size_t begin = 0; begin < code_lengths.size();) {
+    const auto length = code_lengths[begin];
+    auto end = begin + 1;
+    while (end < code_lengths.size() && code_lengths[end] == length) {
+      ++end;
+    }
+    const auto count = end - begin;
+    begin = end;
+
+    if (length == 0) {
+      const auto first_run = num_runs;
+      for (auto num_zeros = count; num_zeros > 0;
+           num_zeros -= last_runs[num_zeros].length) {
+        runs[num_runs++] = last_runs[num_zeros];
+      }
+      std::reverse(runs.begin() + first_run, runs.begin() + num_runs);
+      continue;
+    }
+
+    runs[num_runs++] = CodeLengthRun{.symbol = length, .length = 1};
+    const auto num_repeated = count - 1;
+    // The bits of sending the repeated lengths with a number of repeats,
+    // each as long as possible, and the rest singly.
+    auto repeated_bits = [&](std::size_t num_repeats) {
+      return (num_repeats * run_bits_by_symbol[repeat_previous.symbol]) +
+             (num_repeated -
+              std::min(num_repeated, num_repeats * repeat_previous.max)) *
+                 run_bits_by_symbol[length];
+    };
+    std::size_t num_repeats = 0;
+    for (const auto candidate :
+         {num_repeated / repeat_previous.max,
+          (num_repeated + repeat_previous.max - 1) / repeat_previous.max}) {
+      if (candidate * repeat_previous.min <= num_repeated &&
+          repeated_bits(candidate) < repeated_bits(num_repeats)) {
+        num_repeats = candidate;
+      }
+    }
+    const auto num_covered =
+        std::min(num_repeated, num_repeats * repeat_previous.max);
+    auto num_left = num_covered;
+    for (; num_repeats > 0; --num_repeats) {
+      // Leave at least the minimum for each of the remaining repeats.
+      const auto size = std::min<std::size_t>(
+          repeat_previous.max,
+          num_left - ((num_repeats - 1) * repeat_previous.min));
+      runs[num_runs++] = CodeLengthRun{
+          .symbol = repeat_previous.symbol,
+          .length = static_cast<std::uint8_t>(size)};
+      num_left -= size;
+    }
+    for (auto i = num_covered; i < num_repeated; ++i) {
+      runs[num_runs++] = CodeLengthRun{.symbol = length, .length = 1};
+    }
+  }
+  return num_runs;
+}
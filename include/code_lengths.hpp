@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "package_merge.hpp"
+
+namespace detail {
+
+// Replace the sorted weights with the lengths of an unrestricted Huffman code,
+// in place, in O(n) time.
+//
+// Based on Moffat and Katajainen, "In-place calculation of minimum-redundancy
+// codes" (1995), as described in:
+// https://people.eng.unimelb.edu.au/ammoffat/abstracts/compsurv19moffat.pdf
+inline auto moffat_katajainen(std::span<std::uint64_t> a) -> void {
+  const auto n = a.size();
+  // First pass, left to right, setting parent pointers.
+  a[0] += a[1];
+  std::size_t root = 0;
+  std::size_t leaf = 2;
+  for (std::size_t next = 1; next + 1 < n; ++next) {
+    // Select the first item for a pairing.
+    if (leaf >= n || a[root] < a[leaf]) {
+      a[next] = a[root];
+      a[root++] = next;
+    } else {
+      a[next] = a[leaf++];
+    }
+    // Add on the second item.
+    if (leaf >= n || (root < next && a[root] < a[leaf])) {
+      a[next] += a[root];
+      a[root++] = next;
+    } else {
+      a[next] += a[leaf++];
+    }
+  }
+  // Second pass, right to left, setting internal depths.
+  a[n - 2] = 0;
+  for (std::size_t next = n - 2; next-- > 0;) {
+    a[next] = a[a[next]] + 1;
+  }
+  // Third pass, right to left, setting leaf depths.
+  std::size_t available = 1;
+  std::size_t used = 0;
+  std::uint64_t depth = 0;
+  std::size_t internal = n - 1;
+  std::size_t next = n;
+  while (available > 0) {
+    while (internal > 0 && a[internal - 1] == depth) {
+      used++;
+      internal--;
+    }
+    while (available > used) {
+      a[--next] = depth;
+      available--;
+    }
+    available = 2 * used;
+    depth++;
+    used = 0;
+  }
+}
+
+} // namespace detail
+
+// code_lengths generates Huffman code lengths based on symbol counts/weights,
+// limited to max_length. An unrestricted Huffman code is computed in place in
+// linear time, which is optimal whenever it fits within max_length. Otherwise
+// (rarely, for very skewed weights) package merge is used. Neither allocates.
+template <std::size_t N, typename W = std::size_t>
+auto code_lengths(std::span<W, N> weights, std::uint8_t max_length)
+    -> std::array<std::uint8_t, N> {
+  std::array<std::uint8_t, N> lengths{};
+  const auto sorted = detail::sort_non_zero_weights(weights);
+  if (sorted.size == 0) {
+    return lengths;
+  }
+  if (sorted.size == 1) {
+    // A single non-zero weight still needs a code of length 1.
+    lengths.at(sorted.symbols[0]) = 1;
+    return lengths;
+  }
+
+  auto depths = sorted.weights;
+  detail::moffat_katajainen(std::span(depths.data(), sorted.size));
+  // The smallest weight is the deepest.
+  if (depths[0] <= max_length) {
+    for (std::uint16_t i = 0; i < sorted.size; ++i) {
+      lengths.at(sorted.symbols[i]) = static_cast<std::uint8_t>(depths[i]);
+    }
+    return lengths;
+  }
+
+  const auto sorted_lengths = detail::package_merge_sorted(sorted, max_length);
+  for (std::uint16_t i = 0; i < sorted.size; ++i) {
+    lengths.at(sorted.symbols[i]) = sorted_lengths[i];
+  }
+  return lengths;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+#include "histogram.hpp"
+#include "size.hpp"
+
+// The number of bytes at the start of an input from which its content type is
+// sniffed.
+constexpr std::size_t content_type_sample_size = 1U << 12U;
+
+// ContentType classifies an input by a sample of the bytes at its start, so
+// that the parameters tuned for that type of content can be selected before
+// the input is compressed.
+enum class ContentType : std::uint8_t {
+  // Mostly printable ASCII, e.g. prose, source code and markup.
+  text,
+  // Mostly nucleotide codes, e.g. FASTA sequences, whose alphabet is so small
+  // that prefix codes alone save most of what can be saved.
+  dna,
+  // Anything else, e.g. executables, spreadsheets and images.
+  binary,
+};
+
+namespace detail {
+
+// The nucleotide codes of DNA and RNA, including the code for an unknown
+// nucleotide, in either case, and the line breaks between sequence lines.
+constexpr std::string_view nucleotide_bytes = "ACGTUNacgtun\n\r";
+
+// The least shares of a sample that must be nucleotide bytes, or printable
+// ASCII and whitespace, for it to be DNA or text respectively. These leave room
+// for the header lines of FASTA, and for the odd non-ASCII character of UTF-8.
+constexpr double minimum_nucleotide_share = 0.9;
+constexpr double minimum_text_share = 0.9;
+
+constexpr auto is_text_byte(std::size_t byte) -> bool {
+  constexpr std::size_t first_printable = 0x20;
+  constexpr std::size_t last_printable = 0x7E;
+  return (byte >= first_printable && byte <= last_printable) || byte == '\t' ||
+         byte == '\n' || byte == '\r' || byte == '\f';
+}
+
+} // namespace detail
+
+// Sniff the content type of an input from the byte histogram of a sample of
+// its start. An empty sample is text.
+inline auto sniff_content_type(std::span<const std::uint8_t> sample)
+    -> ContentType {
+  if (sample.empty()) {
+    return ContentType::text;
+  }
+  Histogram<1U << size_of_in_bits<std::uint8_t>()> count_by_byte;
+  count_by_byte.add(sample);
+  const auto counts = count_by_byte.counts();
+
+  std::size_t num_nucleotide_bytes = 0;
+  for (const auto byte : detail::nucleotide_bytes) {
+    num_nucleotide_bytes += counts.at(static_cast<std::uint8_t>(byte));
+  }
+  std::size_t num_text_bytes = 0;
+  for (std::size_t byte = 0; byte < counts.size(); ++byte) {
+    if (detail::is_text_byte(byte)) {
+      num_text_bytes += counts.at(byte);
+    }
+  }
+
+  const auto size = static_cast<double>(sample.size());
+  if (static_cast<double>(num_nucleotide_bytes) >=
+      detail::minimum_nucleotide_share * size) {
+    return ContentType::dna;
+  }
+  if (static_cast<double>(num_text_bytes) >=
+      detail::minimum_text_share * size) {
+    return ContentType::text;
+  }
+  return ContentType::binary;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace detail {
+
+// The CRC-32 polynomial used by gz, with its bits reversed, since bits are
+// processed least significant first.
+constexpr std::uint32_t crc32_polynomial = 0xEDB88320U;
+
+constexpr std::size_t crc32_table_size = 256;
+
+// Compute the CRC-32 remainder of each byte, so that bytes can be processed
+// a byte at a time. The table is built at compile time, so that computing a
+// CRC costs nothing up front.
+constexpr auto get_crc32_table()
+    -> std::array<std::uint32_t, crc32_table_size> {
+  std::array<std::uint32_t, crc32_table_size> table{};
+  for (std::uint32_t byte = 0; byte < table.size(); ++byte) {
+    auto remainder = byte;
+    for (auto bit = 0; bit < 8; ++bit) { // NOLINT (*-avoid-magic-numbers)
+      remainder = (remainder & 1U) != 0 ? (remainder >> 1U) ^ crc32_polynomial
+                                        : remainder >> 1U;
+    }
+    table.at(byte) = remainder;
+  }
+  return table;
+}
+
+constexpr std::array<std::uint32_t, crc32_table_size> crc32_table{
+    get_crc32_table()};
+
+} // namespace detail
+
+// Return the CRC-32 of the bytes that crc is the CRC-32 of, followed by
+// bytes. The CRC-32 of no bytes is 0, so a CRC-32 can be computed
+// incrementally starting from 0.
+constexpr auto crc32(std::uint32_t crc, std::span<const std::uint8_t> bytes)
+    -> std::uint32_t {
+  crc = ~crc;
+  for (const auto byte : bytes) {
+    crc = detail::crc32_table[(crc ^ byte) & 0xFFU] ^ (crc >> 8U);
+  }
+  return ~crc;
+}
@@ -1,7 +1,7 @@
 #pragma once
 
-#include <cstddef>
 #include <cstdint>
+#include <span>
 
 #include "gz.hpp"
 #include "types.hpp"
@@ -11,9 +11,7 @@ namespace deflate {
 class BitStreamMixin : public gz::BitStreamMixin {
 public:
   auto push_prefix_code(PrefixCode prefix_code) -> void;
-  auto push_offset(Offset offset) -> void;
-  auto push_back_reference(PrefixCodedBackReference prefix_coded_back_reference)
-      -> void;
+  auto push_code_word(CodeWord code_word) -> void;
 
 private:
   template <typename Integral>
@@ -29,27 +27,12 @@ public:
   explicit BitStream(gz::BitStream &bit_stream);
 
   auto push_bit(std::uint8_t b) -> void override;
+  auto push_word(std::uint32_t b, std::uint8_t num_bits) -> void override;
+  auto push_bytes(std::span<const std::uint8_t> bytes) -> void override;
   auto flush_byte() -> void override;
 
 private:
   gz::BitStream &wrapped_;
 };
 
-class BufferedBitStream final : public BitStreamMixin {
-public:
-  explicit BufferedBitStream(gz::BitStream &bit_stream);
-
-  auto push_bit(std::uint8_t b) -> void override;
-  auto flush_byte() -> void override;
-
-  [[nodiscard]] auto bits() const -> std::size_t;
-  auto commit() -> void;
-  auto reset() -> void;
-  auto unbuffered() -> BitStream &;
-
-private:
-  gz::BufferedBitStream wrapped_;
-  BitStream unbuffered_;
-};
-
 } // namespace deflate
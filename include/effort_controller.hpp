@@ -0,0 +1,115 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "constants.hpp"
+#include "lzss.hpp"
+
+// Coding selects how the input is coded, from the fastest to the smallest.
+enum class Coding : std::uint8_t {
+  // Stored in blocks of type 0.
+  stored,
+  // As literals only, compressed by their prefix codes alone.
+  literals,
+  // As literals and back references, found by the match finder.
+  back_references,
+};
+
+// The effort spent compressing the input, which is traded for speed to meet a
+// target throughput.
+struct Effort {
+  Coding coding;
+  // The most occurrences visited by each search of the match finder.
+  std::uint16_t maximum_chain_visits;
+  // The longest back reference whose positions are all indexed.
+  std::uint16_t maximum_indexed_length;
+};
+
+// The efforts that the effort controller chooses between, from the least to
+// the most. The most is the effort spent without a target. Coding literals
+// only is several times faster than searching for back references, and
+// storing faster still, while the searches of the last levels differ by less
+// than 1.5 times in speed, and about 12% in size.
+constexpr std::array efforts{
+    Effort{.coding = Coding::stored,
+           .maximum_chain_visits = 0,
+           .maximum_indexed_length = 0},
+    Effort{.coding = Coding::literals,
+           .maximum_chain_visits = 0,
+           .maximum_indexed_length = 0},
+    Effort{.coding = Coding::back_references,
+           .maximum_chain_visits = 4,
+           .maximum_indexed_length = 4},
+    Effort{.coding = Coding::back_references,
+           .maximum_chain_visits = 16,
+           .maximum_indexed_length = 16},
+    Effort{.coding = Coding::back_references,
+           .maximum_chain_visits = 128,
+           .maximum_indexed_length = maximum_look_ahead_size},
+    Effort{.coding = Coding::back_references,
+           .maximum_chain_visits = maximum_chain_visits,
+           .maximum_indexed_length = maximum_look_ahead_size},
+};
+
+// The number of bytes of input between adjustments of the effort.
+constexpr std::size_t effort_interval = 1U << 16U;
+
+// The most intervals of time that the effort controller banks, when the input
+// is ahead of its schedule.
+constexpr std::size_t maximum_banked_effort_intervals = 16;
+
+// EffortController paces compression to a target throughput. It keeps the
+// time by which the input is ahead of its schedule at the target, and after
+// each interval of the input, lowers the effort by one level while it is
+// behind and the interval took longer than scheduled, and raises it by one
+// level while it is more than an interval ahead. The levels on either side
+// of the target then alternate, so that the throughput averages the target,
+// and the effort is the most that it allows. The time kept is bounded on
+// both sides, so that time saved on easy input is not all spent at once on
+// hard input, and vice versa.
+class EffortController {
+private:
+  double target_bytes_per_second_;
+  double slack_seconds_ = 0.0;
+  std::size_t level_ = efforts.size() - 1;
+
+public:
+  explicit EffortController(double target_bytes_per_second)
+      : target_bytes_per_second_{target_bytes_per_second} {}
+
+  [[nodiscard]] auto effort() const -> const Effort & {
+    return efforts.at(level_);
+  }
+
+  [[nodiscard]] auto target_bytes_per_second() const -> double {
+    return target_bytes_per_second_;
+  }
+
+  auto set_target_bytes_per_second(double target_bytes_per_second) {
+    target_bytes_per_second_ = target_bytes_per_second;
+  }
+
+  // Account for num_bytes of input compressed in seconds, and adjust the
+  // effort for the bytes that follow. Return whether the effort changed.
+  auto step(std::size_t num_bytes, double seconds) -> bool {
+    const auto scheduled_seconds =
+        static_cast<double>(num_bytes) / target_bytes_per_second_;
+    const auto maximum_slack_seconds =
+        static_cast<double>(maximum_banked_effort_intervals) *
+        scheduled_seconds;
+    slack_seconds_ =
+        std::clamp(slack_seconds_ + scheduled_seconds - seconds,
+                   -maximum_slack_seconds, maximum_slack_seconds);
+    const auto level = level_;
+    if (slack_seconds_ < 0.0 && seconds > scheduled_seconds && level_ > 0) {
+      --level_;
+    } else if (slack_seconds_ > scheduled_seconds &&
+               level_ + 1 < efforts.size()) {
+      ++level_;
+    }
+    return level_ != level;
+  }
+};
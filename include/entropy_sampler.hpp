@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "histogram.hpp"
+#include "size.hpp"
+
+// The number of bytes in each sample whose entropy is measured.
+constexpr std::size_t entropy_sample_size = 1U << 12U;
+
+// EntropySampler measures the order-0 entropy of consecutive samples of the
+// bytes stepped through it, i.e. the fewest bits per byte that any prefix code
+// for the sample could average, before any repeated strings are found. Bytes
+// that are already compressed or encrypted have an entropy close to 8 bits
+// per byte, and an empirical entropy of about 7.95 over 4 KiB samples.
+template <std::size_t SampleSize = entropy_sample_size> class EntropySampler {
+private:
+  Histogram<1U << size_of_in_bits<std::uint8_t>()> count_by_byte_;
+  std::size_t num_bytes_ = 0;
+  double entropy_ = 0.0;
+
+public:
+  // Count a byte into the current sample, and return whether it completed
+  // the sample. The entropy of the sample is then returned by entropy() until
+  // the next sample is completed.
+  auto step(std::uint8_t byte) -> bool {
+    count_by_byte_.add(byte);
+    if (++num_bytes_ < SampleSize) {
+      return false;
+    }
+    entropy_ = 0.0;
+    for (const auto count : count_by_byte_.counts()) {
+      if (count > 0) {
+        const auto probability = static_cast<double>(count) / SampleSize;
+        entropy_ -= probability * std::log2(probability);
+      }
+    }
+    count_by_byte_.reset();
+    num_bytes_ = 0;
+    return true;
+  }
+
+  // Return the entropy of the last completed sample, in bits per byte.
+  [[nodiscard]] auto entropy() const -> double { return entropy_; }
+};
@@ -3,7 +3,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <ostream>
-#include <vector>
+#include <span>
 
 #include "size.hpp"
 
@@ -40,6 +40,20 @@ public:
   virtual auto push_bit(std::uint8_t b) -> void = 0;
   virtual auto flush_byte() -> void = 0;
 
+  // Push the lowest num_bits (at most 32) bits of b, least significant bit
+  // first. The remaining bits of b must be zero.
+  virtual auto push_word(std::uint32_t b, std::uint8_t num_bits) -> void {
+    push_bits(b, num_bits);
+  }
+
+  // Push whole bytes, which are copied as they are when the stream is on a
+  // byte boundary.
+  virtual auto push_bytes(std::span<const std::uint8_t> bytes) -> void {
+    for (const auto byte : bytes) {
+      push_word(byte, size_of_in_bits(byte));
+    }
+  }
+
   auto push_header() -> void;
   auto push_footer(std::uint32_t crc_on_uncompressed,
                    std::uint32_t num_bytes_uncompressed) -> void;
@@ -57,6 +71,8 @@ public:
   auto operator=(BitStream &&) -> BitStream & = delete;
 
   auto push_bit(std::uint8_t b) -> void override;
+  auto push_word(std::uint32_t b, std::uint8_t num_bits) -> void override;
+  auto push_bytes(std::span<const std::uint8_t> bytes) -> void override;
   auto flush_byte() -> void override;
 
 private:
@@ -65,23 +81,4 @@ private:
   std::ostream &out_;
 };
 
-class BufferedBitStream final : public BitStreamMixin {
-public:
-  explicit BufferedBitStream(BitStream &bit_stream);
-
-  auto push_bit(std::uint8_t b) -> void override;
-  auto flush_byte() -> void override;
-
-  [[nodiscard]] auto bits() const -> std::size_t;
-  auto commit() -> void;
-  auto reset() -> void;
-  auto unbuffered() -> BitStream &;
-
-private:
-  std::uint8_t bits_;
-  std::uint8_t num_bits_;
-  BitStream &wrapped_;
-  std::vector<std::uint8_t> buffer_;
-};
-
 } // namespace gz
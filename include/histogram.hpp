@@ -0,0 +1,98 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+#include "size.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Histogram counts symbol occurrences using several interleaved count tables
+// that are merged when the counts are read. Consecutive increments land in
+// different tables, so runs of the same symbol (e.g. a65536.txt) do not
+// serialize on a store-to-load dependency through a single counter.
+//
+// References:
+// https://fastcompression.blogspot.com/2014/09/counting-bytes-fast-little-trick-from.html
+template <std::size_t N, std::size_t Lanes = 4> class Histogram {
+public:
+  using Count = std::uint32_t;
+
+private:
+  static_assert(Lanes > 0 && (Lanes & (Lanes - 1)) == 0,
+                "Lanes must be a power of two");
+
+  std::array<std::array<Count, N>, Lanes> counts_by_lane_{};
+  std::size_t lane_{0};
+
+public:
+  auto reset() -> void {
+    for (auto &counts : counts_by_lane_) {
+      counts.fill(0);
+    }
+    lane_ = 0;
+  }
+
+  auto add(std::size_t symbol) -> void {
+    counts_by_lane_[lane_][symbol]++;
+    lane_ = (lane_ + 1) & (Lanes - 1);
+  }
+
+  // Count a run of bytes, reading a machine word at a time and spreading its
+  // bytes across the count tables. The increments are scattered stores, which
+  // AVX2 has no instruction for, so only merging the tables is vectorized.
+  auto add(std::span<const std::uint8_t> bytes) -> void {
+    static_assert(N >= (1U << size_of_in_bits<std::uint8_t>()));
+    constexpr auto word_size = sizeof(std::uint64_t);
+    const auto *it = bytes.data();
+    const auto *const end = it + bytes.size();
+    for (; end - it >= static_cast<std::ptrdiff_t>(word_size);
+         it += word_size) {
+      std::uint64_t word{};
+      std::memcpy(&word, it, word_size);
+      add_word(word);
+    }
+    for (; it != end; ++it) {
+      add(*it);
+    }
+  }
+
+  // Merge the count tables into a single count per symbol.
+  [[nodiscard]] auto counts() const -> std::array<Count, N> {
+    std::array<Count, N> merged = counts_by_lane_[0];
+    for (std::size_t lane = 1; lane < Lanes; ++lane) {
+      std::size_t i = 0;
+#if defined(__AVX2__)
+      constexpr auto counts_per_vector = sizeof(__m256i) / sizeof(Count);
+      for (; i + counts_per_vector <= N; i += counts_per_vector) {
+        auto *merged_ptr = reinterpret_cast<__m256i *>(&merged[i]);
+        const auto *lane_ptr =
+            reinterpret_cast<const __m256i *>(&counts_by_lane_[lane][i]);
+        _mm256_storeu_si256(merged_ptr,
+                            _mm256_add_epi32(_mm256_loadu_si256(merged_ptr),
+                                             _mm256_loadu_si256(lane_ptr)));
+      }
+#endif
+      for (; i < N; ++i) {
+        merged[i] += counts_by_lane_[lane][i];
+      }
+    }
+    return merged;
+  }
+
+private:
+  // Count the bytes of a word, spreading them across the count tables.
+  auto add_word(std::uint64_t word) -> void {
+    constexpr auto byte_mask = 0xFFU;
+    constexpr auto bits_per_byte = size_of_in_bits<std::uint8_t>();
+    for (std::size_t i = 0; i < sizeof(word); ++i) {
+      counts_by_lane_[i & (Lanes - 1)][(word >> (i * bits_per_byte)) &
+                                       byte_mask]++;
+    }
+  }
+};
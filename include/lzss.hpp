@@ -1,26 +1,99 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <memory_resource>
+#include <random>
 #include <unordered_map>
 #include <utility>
 
+#include "arena.hpp"
 #include "constants.hpp"
 #include "ring_buffer.hpp"
 #include "size.hpp"
 #include "types.hpp"
 
+// The number of occurrences visited in the chains of the match finder is
+// bounded, so that no input can make it take more than linear time. Each
+// search visits at most maximum_chain_visits occurrences. Besides, each byte
+// taken earns chain_visits_per_byte visits, up to maximum_chain_visit_credit
+// in total, and once the visits made exceed those earned, each search visits
+// at most throttled_chain_visits occurrences until enough are earned again.
+// Ordinary inputs rarely exhaust either budget, so they compress as if the
+// chains were walked in full, while an input crafted to make every chain
+// long (such as random bytes over a tiny alphabet) is searched far less
+// thoroughly, but at a guaranteed rate.
+constexpr std::size_t maximum_chain_visits = 1U << 12U;
+constexpr std::size_t chain_visits_per_byte = 1U << 5U;
+constexpr std::size_t maximum_chain_visit_credit = 1U << 20U;
+constexpr std::size_t throttled_chain_visits = 1U << 3U;
+
+// Counts of the work done by the match finder, to report when the budgets of
+// its chain visits are exhausted.
+struct MatchFinderCounters {
+  // The number of searches for a back reference, and the occurrences visited
+  // in their chains.
+  std::uint64_t num_searches = 0;
+  std::uint64_t num_chain_visits = 0;
+  // The number of searches that ran out of visits before the end of their
+  // chain.
+  std::uint64_t num_truncated_searches = 0;
+  // The number of searches made with at most throttled_chain_visits, since
+  // the visits earned were exhausted.
+  std::uint64_t num_throttled_searches = 0;
+
+  auto operator+=(const MatchFinderCounters &other) -> MatchFinderCounters & {
+    num_searches += other.num_searches;
+    num_chain_visits += other.num_chain_visits;
+    num_truncated_searches += other.num_truncated_searches;
+    num_throttled_searches += other.num_throttled_searches;
+    return *this;
+  }
+};
+
+namespace detail {
+
+// Hash a three-byte pattern by multiplying it with a random odd number drawn
+// once per process, keeping the high bits. With the identity hash of the
+// standard library, an input could be crafted whose patterns all fall into
+// one bucket of the hash map, making each lookup linear in the number of
+// patterns. The buckets do not affect the back references found, so the
+// output does not depend on the number drawn.
+struct PatternHash {
+  static auto multiplier() -> std::uint64_t {
+    static const std::uint64_t multiplier = [] {
+      std::random_device random_device;
+      return (std::uint64_t{random_device()} << 32U) | random_device() | 1U;
+    }();
+    return multiplier;
+  }
+
+  auto operator()(std::uint32_t pattern_key) const -> std::size_t {
+    return (pattern_key * multiplier()) >> 32U;
+  }
+};
+
+} // namespace detail
+
 template <std::size_t LookBackSize = maximum_look_back_size,
           std::size_t LookAheadSize = maximum_look_ahead_size>
 class Lzss {
 private:
   using LookAheadRingBuffer = RingBuffer<std::uint8_t, LookAheadSize>;
-  using ChainRingBuffer = RingBuffer<std::uint64_t, LookBackSize>;
-
-  RingBuffer<std::uint8_t, LookBackSize> look_back_{};
-  LookAheadRingBuffer look_ahead_{};
-  // chain_ is a ring buffer that stores the absolute position of the previous
-  // starting point of the same three-byte pattern in the look-back buffer.
+  using ChainRingBuffer = RingBuffer<std::uint16_t, LookBackSize>;
+  static_assert(LookBackSize <= (1U << 16U),
+                "Distances within the look-back buffer must fit in 16 bits");
+
+  // The ring buffers are default-initialized, which leaves their elements
+  // uninitialized (see RingBuffer).
+  RingBuffer<std::uint8_t, LookBackSize> look_back_;
+  LookAheadRingBuffer look_ahead_;
+  // chain_ is a ring buffer that stores the distance back to the previous
+  // starting point of the same three-byte pattern in the look-back buffer, or
+  // end_of_chain if there is none. Distances are bounded by the size of the
+  // look-back buffer, so they take a quarter of the space of the absolute
+  // positions they are relative to.
   // Together with start_absolute_by_length_three_pattern_, this forms a chain
   // of occurrences for each three-byte pattern in the look-back buffer.
   // Three-byte patterns are used as they are the minimum length pattern
@@ -30,13 +103,35 @@ private:
   // due to the large branching factor, which otherwise grows in memory quickly
   // if 256 8-byte pointers are naively reserved in each node for possible
   // children.
-  ChainRingBuffer chain_{};
+  ChainRingBuffer chain_;
+  // The nodes of the hash map are allocated from a free list, to which they
+  // are returned when their pattern leaves the look-back buffer. The number of
+  // patterns is bounded by the size of the look-back buffer, so once the free
+  // list (and the buckets of the hash map) have grown to fit it, adding
+  // patterns no longer touches the heap.
+  FreeList pattern_nodes_;
   // start_absolute_by_length_three_pattern_ is a hash map that maps three-byte
   // patterns to the absolute position of the most recent occurrence of the
   // pattern in the look-back buffer.
-  std::unordered_map<std::uint32_t, std::uint64_t>
-      start_absolute_by_length_three_pattern_;
+  std::pmr::unordered_map<std::uint32_t, std::uint64_t, detail::PatternHash>
+      start_absolute_by_length_three_pattern_{&pattern_nodes_};
+  // The key of the pattern added last, and its entry in the hash map, or
+  // nullptr if it has none. Within a run, every position has the same
+  // pattern, so it is added and removed through this entry without hashing.
+  // Entries of the hash map stay put when it grows, so the entry is only
+  // forgotten when it is erased.
+  std::uint32_t last_pattern_key_{};
+  std::uint64_t *last_pattern_start_absolute_ = nullptr;
   BackReference back_reference_{.distance = 0, .length = 0};
+  // The chain visits earned by the bytes taken and not yet made, which is
+  // negative by at most maximum_chain_visits once they are exhausted.
+  std::int64_t chain_visit_credit_{maximum_chain_visit_credit};
+  // The most occurrences that each search visits, up to maximum_chain_visits.
+  std::size_t maximum_visits_{maximum_chain_visits};
+  // Every position of a back reference up to this long is indexed, but only
+  // the first position of a longer one, as in the fast levels of zlib.
+  std::size_t maximum_indexed_length_{LookAheadSize};
+  MatchFinderCounters counters_;
   std::uint64_t absolute_position_{
       1}; // Start at 1 to reserve 0 for end of chain
 
@@ -81,19 +176,34 @@ private:
     auto pattern_key = create_pattern_key(look_back_[start_relative],
                                           look_ahead_[0], look_ahead_[1]);
 
+    const auto start_absolute = relative_to_absolute(start_relative);
+    if (last_pattern_start_absolute_ != nullptr &&
+        pattern_key == last_pattern_key_ &&
+        is_absolute_in_lookback(*last_pattern_start_absolute_)) {
+      chain_.enqueue(static_cast<std::uint16_t>(
+          start_absolute - *last_pattern_start_absolute_));
+      *last_pattern_start_absolute_ = start_absolute;
+      return;
+    }
+
     // Check if this pattern already exists in hash map
     auto it = start_absolute_by_length_three_pattern_.find(pattern_key);
-    if (it != start_absolute_by_length_three_pattern_.end()) {
-      // Pattern exists, store the previous occurrence in chain
-      chain_.enqueue(it->second);
+    if (it != start_absolute_by_length_three_pattern_.end() &&
+        is_absolute_in_lookback(it->second)) {
+      // Pattern exists, store the distance to the previous occurrence in
+      // chain
+      chain_.enqueue(
+          static_cast<std::uint16_t>(start_absolute - it->second));
     } else {
-      // New pattern, no previous occurrence
+      // New pattern, or no previous occurrence that can still be reached
       chain_.enqueue(end_of_chain);
     }
 
     // Update the hash map with the new position
-    start_absolute_by_length_three_pattern_[pattern_key] =
-        relative_to_absolute(start_relative);
+    last_pattern_key_ = pattern_key;
+    last_pattern_start_absolute_ =
+        &(start_absolute_by_length_three_pattern_[pattern_key] =
+              start_absolute);
   }
 
   // Remove pattern from hash map and chain
@@ -104,15 +214,39 @@ private:
     chain_.dequeue();
     auto pattern_key =
         create_pattern_key(look_back_[0], look_back_[1], look_back_[2]);
+    if (last_pattern_start_absolute_ != nullptr &&
+        pattern_key == last_pattern_key_ &&
+        absolute_to_relative(*last_pattern_start_absolute_) != 0) {
+      // The pattern has occurred since, so its entry stays.
+      return;
+    }
     auto it = start_absolute_by_length_three_pattern_.find(pattern_key);
     if (it == start_absolute_by_length_three_pattern_.end()) {
       return;
     }
     if (absolute_to_relative(it->second) == 0) {
+      if (&it->second == last_pattern_start_absolute_) {
+        last_pattern_start_absolute_ = nullptr;
+      }
       start_absolute_by_length_three_pattern_.erase(it);
     }
   }
 
+  // Return the length of the run of the last byte of the look-back buffer at
+  // the start of the look-ahead buffer, i.e. of the back reference with a
+  // distance of one.
+  auto run_length() const -> std::size_t {
+    if (look_back_.is_empty()) {
+      return 0;
+    }
+    const auto byte = look_back_[look_back_.size() - 1];
+    std::size_t length = 0;
+    while (length < look_ahead_.size() && look_ahead_[length] == byte) {
+      ++length;
+    }
+    return length;
+  }
+
   // Find best back reference using hash map with chain
   auto find_best_back_reference() -> BackReference {
     auto longest_backref = BackReference{.distance = 0, .length = 0};
@@ -121,6 +255,13 @@ private:
       return longest_backref;
     }
 
+    // A run that fills the look-ahead buffer is the longest back reference,
+    // and the nearest, so it is taken without walking the chain, which in a
+    // long run holds every position of the run.
+    if (const auto length = run_length(); length == look_ahead_.size()) {
+      return BackReference{.distance = 1, .length = length};
+    }
+
     auto pattern_key =
         create_pattern_key(look_ahead_[0], look_ahead_[1], look_ahead_[2]);
     auto it = start_absolute_by_length_three_pattern_.find(pattern_key);
@@ -140,8 +281,29 @@ private:
         BackReference{.distance = look_back_.size() - start_relative,
                       .length = minimum_back_reference_length};
 
-    // Follow the chain of all occurrences of this pattern
-    while (is_absolute_in_lookback(start_absolute)) {
+    const auto is_throttled = chain_visit_credit_ <= 0;
+    const auto maximum_visits =
+        is_throttled ? std::min(throttled_chain_visits, maximum_visits_)
+                     : maximum_visits_;
+    std::size_t num_visits = 0;
+    // Follow the chain of occurrences of this pattern, from the nearest,
+    // until a back reference fills the look-ahead buffer, since no later one
+    // can be longer, or the visits run out.
+    for (; is_absolute_in_lookback(start_absolute) &&
+           longest_backref.length < look_ahead_.size() &&
+           num_visits < maximum_visits;
+         ++num_visits) {
+      // An occurrence can only give a longer back reference if it matches
+      // the byte just past the longest so far, which is checked first. Within
+      // a run, this rejects each occurrence whose run is longer or shorter
+      // than the run in the look-ahead buffer without matching the run.
+      if (!matches_at(start_relative, longest_backref.length)) {
+        const auto distance = chain_[start_relative];
+        start_absolute =
+            distance == end_of_chain ? end_of_chain : start_absolute - distance;
+        start_relative = absolute_to_relative(start_absolute);
+        continue;
+      }
 
       // Match as many characters as possible
       for (auto current_lookahead = minimum_back_reference_length;
@@ -163,13 +325,36 @@ private:
         longest_backref.length = current_lookahead + 1;
       }
 
-      start_absolute = chain_[start_relative];
+      const auto distance = chain_[start_relative];
+      start_absolute =
+          distance == end_of_chain ? end_of_chain : start_absolute - distance;
       start_relative = absolute_to_relative(start_absolute);
     }
 
+    chain_visit_credit_ -= static_cast<std::int64_t>(num_visits);
+    counters_.num_searches++;
+    counters_.num_chain_visits += num_visits;
+    if (is_absolute_in_lookback(start_absolute) &&
+        longest_backref.length < look_ahead_.size()) {
+      counters_.num_truncated_searches++;
+    }
+    if (is_throttled) {
+      counters_.num_throttled_searches++;
+    }
     return longest_backref;
   }
 
+  // Whether the byte at the given index of the look-ahead buffer matches the
+  // byte it would be copied from by a back reference starting at
+  // start_relative in the look-back buffer.
+  auto matches_at(std::size_t start_relative, std::size_t index) const -> bool {
+    const auto distance = look_back_.size() - start_relative;
+    const auto relative =
+        distance < look_ahead_.size() ? start_relative + (index % distance)
+                                      : start_relative + index;
+    return look_back_[relative] == look_ahead_[index];
+  }
+
   auto cache_back_reference() {
     if (back_reference_.length > 0) {
       return;
@@ -184,16 +369,44 @@ private:
     back_reference_ = BackReference{.distance = 0, .length = 0};
   }
 
-  auto take_literal_() {
+  // Take the next byte into the look-back buffer, indexing the pattern that
+  // starts with it unless is_indexed is false, in which case no search can
+  // find it.
+  auto take_literal_(bool is_indexed = true) {
+    chain_visit_credit_ = std::min<std::int64_t>(
+        chain_visit_credit_ + chain_visits_per_byte,
+        maximum_chain_visit_credit);
     remove_pattern();
     look_back_.enqueue(look_ahead_.dequeue());
     absolute_position_++;
-    add_pattern();
+    if (is_indexed) {
+      add_pattern();
+    } else {
+      chain_.enqueue(end_of_chain);
+    }
   }
 
 public:
   auto is_empty() const -> bool { return look_ahead_.is_empty(); }
 
+  [[nodiscard]] auto counters() const -> const MatchFinderCounters & {
+    return counters_;
+  }
+
+  // Set the most occurrences that each search visits from here on, between
+  // one and maximum_chain_visits, trading ratio for speed.
+  auto set_maximum_chain_visits(std::size_t maximum_visits) {
+    maximum_visits_ = std::clamp<std::size_t>(maximum_visits, 1,
+                                              maximum_chain_visits);
+  }
+
+  // Set the longest back reference whose positions are all indexed from
+  // here on; only the first position of a longer one is indexed, trading
+  // ratio for speed.
+  auto set_maximum_indexed_length(std::size_t maximum_indexed_length) {
+    maximum_indexed_length_ = maximum_indexed_length;
+  }
+
   auto is_full() const -> bool { return look_ahead_.is_full(); }
 
   auto literal() const -> std::uint8_t { return look_ahead_.peek(); }
@@ -215,8 +428,10 @@ public:
 
   auto take_back_reference() {
     cache_back_reference();
+    const auto is_indexed =
+        back_reference_.length <= maximum_indexed_length_;
     for (auto i = 0; std::cmp_less(i, back_reference_.length); ++i) {
-      take_literal_();
+      take_literal_(is_indexed || i == 0);
     }
     clear_cached_back_reference();
   }
@@ -230,4 +445,14 @@ public:
     look_ahead_.enqueue(literal);
     clear_cached_back_reference();
   }
+
+  // Forget the look-back buffer, so that no back reference reaches the bytes
+  // taken so far.
+  auto clear_look_back() {
+    look_back_.clear();
+    chain_.clear();
+    start_absolute_by_length_three_pattern_.clear();
+    last_pattern_start_absolute_ = nullptr;
+    clear_cached_back_reference();
+  }
 };
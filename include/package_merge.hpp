@@ -2,102 +2,135 @@
 
 #include <algorithm>
 #include <array>
+#include <bitset>
 #include <cstddef>
 #include <cstdint>
 #include <limits>
 #include <span>
-#include <vector>
+#include <stdexcept>
 
 namespace detail {
 
-template <typename W> struct Package {
-  W weight;
-  std::vector<std::uint16_t> indices;
+// The maximum code length supported by the fixed package-merge workspace.
+constexpr std::uint8_t maximum_package_merge_length = 32;
+
+// The symbols with non-zero weights, sorted by ascending weight (ties broken
+// by symbol), along with their weights.
+template <std::size_t N> struct SortedWeights {
+  std::array<std::uint16_t, N> symbols;
+  std::array<std::uint64_t, N> weights;
+  std::uint16_t size;
 };
 
-template <typename W>
-auto comparePackages(const Package<W> &a, const Package<W> &b) -> bool {
-  return a.weight < b.weight;
+template <std::size_t N, typename W>
+auto sort_non_zero_weights(std::span<W, N> weights) -> SortedWeights<N> {
+  static_assert(N <= std::numeric_limits<std::uint16_t>::max());
+  SortedWeights<N> sorted{};
+  for (std::uint16_t i = 0; i < N; ++i) {
+    if (weights[i] != 0) {
+      sorted.symbols[sorted.size++] = i;
+    }
+  }
+  std::sort(sorted.symbols.begin(), sorted.symbols.begin() + sorted.size,
+            [&weights](const std::uint16_t a, const std::uint16_t b) {
+              return weights[a] < weights[b] ||
+                     (weights[a] == weights[b] && a < b);
+            });
+  for (std::uint16_t i = 0; i < sorted.size; ++i) {
+    sorted.weights[i] = weights[sorted.symbols[i]];
+  }
+  return sorted;
+}
+
+// Generate optimal length-limited code lengths for at least two sorted
+// weights, in the order of the sorted weights.
+//
+// Rather than carrying the symbols of each package, only the weights of the
+// current level and whether each item of each level is a package are kept.
+// Since the leaves of each level are merged in sorted order, the leaves
+// selected at a level are always a prefix of the sorted weights, so their
+// number is enough to recover the code lengths.
+template <std::size_t N>
+auto package_merge_sorted(const SortedWeights<N> &sorted,
+                          std::uint8_t max_length)
+    -> std::array<std::uint8_t, N> {
+  const std::size_t num_leaves = sorted.size;
+  if (max_length > maximum_package_merge_length ||
+      (std::size_t{1} << max_length) < num_leaves) {
+    throw std::invalid_argument(
+        "Cannot generate code lengths within the maximum length");
+  }
+
+  std::array<std::bitset<2 * N>, maximum_package_merge_length>
+      is_package_by_level{};
+  std::array<std::uint64_t, 2 * N> items{};
+  std::array<std::uint64_t, 2 * N> next_items{};
+  std::copy_n(sorted.weights.begin(), num_leaves, items.begin());
+  std::size_t num_items = num_leaves;
+  for (std::uint8_t level = 1; level < max_length; ++level) {
+    const auto num_packages = num_items / 2;
+    std::size_t package = 0;
+    std::size_t leaf = 0;
+    std::size_t num_next_items = 0;
+    while (package < num_packages || leaf < num_leaves) {
+      const auto is_leaf_next =
+          leaf < num_leaves &&
+          (package == num_packages ||
+           sorted.weights[leaf] <=
+               items[2 * package] + items[(2 * package) + 1]);
+      if (is_leaf_next) {
+        next_items[num_next_items++] = sorted.weights[leaf++];
+        continue;
+      }
+      is_package_by_level[level].set(num_next_items);
+      next_items[num_next_items++] =
+          items[2 * package] + items[(2 * package) + 1];
+      package++;
+    }
+    std::swap(items, next_items);
+    num_items = num_next_items;
+  }
+
+  std::array<std::uint8_t, N> lengths{};
+  std::size_t num_selected = (2 * num_leaves) - 2;
+  for (std::uint8_t level = max_length; level-- > 0;) {
+    std::size_t num_selected_packages = 0;
+    for (std::size_t i = 0; i < num_selected; ++i) {
+      num_selected_packages += is_package_by_level[level][i] ? 1 : 0;
+    }
+    const auto num_selected_leaves = num_selected - num_selected_packages;
+    for (std::size_t i = 0; i < num_selected_leaves; ++i) {
+      lengths[i]++;
+    }
+    num_selected = 2 * num_selected_packages;
+  }
+  return lengths;
 }
 
 } // namespace detail
 
 // package_merge generates Huffman code lengths based on symbol counts/weights.
+// It needs no allocations, running in O(N * max_length) time within a fixed
+// workspace.
 template <std::size_t N, typename W = std::size_t>
 auto package_merge(std::span<W, N> weights, std::uint8_t max_length)
     -> std::array<std::uint8_t, N> {
   // https://people.eng.unimelb.edu.au/ammoffat/abstracts/compsurv19moffat.pdf
-  static_assert(N <= std::numeric_limits<std::uint16_t>::max());
   std::array<std::uint8_t, N> lengths{};
-  std::vector<std::vector<detail::Package<W>>> packages_by_level(max_length);
-  for (std::uint16_t i = 0; i < weights.size(); ++i) {
-    if (weights[i] == 0) {
-      continue;
-    }
-    packages_by_level.at(0).push_back({weights[i], {i}});
-  }
-  const std::uint16_t num_non_zero_weights = packages_by_level.at(0).size();
-  if (num_non_zero_weights == 0) {
+  const auto sorted = detail::sort_non_zero_weights(weights);
+  if (sorted.size == 0) {
     return lengths;
   }
-  if (num_non_zero_weights == 1) {
+  if (sorted.size == 1) {
     // Length at least 1 is required for a single non-zero weight to
     // differentiate from 0 lengths for missing weights. Otherwise,
     // package-merge would assign a length of 0 to the single non-zero weight.
-    lengths.at(packages_by_level.at(0).at(0).indices.at(0))++;
+    lengths.at(sorted.symbols[0]) = 1;
     return lengths;
   }
-  std::ranges::sort(packages_by_level.at(0), detail::comparePackages<W>);
-  for (std::uint8_t level = 1; level < max_length; ++level) {
-    std::vector<detail::Package<W>> &curr_packages =
-        packages_by_level.at(level);
-    std::vector<detail::Package<W>> &prev_packages =
-        packages_by_level.at(level - 1);
-    for (std::uint16_t first = 0; first + 1 < prev_packages.size();
-         first += 2) {
-      const detail::Package<W> &first_package = prev_packages.at(first);
-      const detail::Package<W> &second_package = prev_packages.at(first + 1);
-      curr_packages.emplace_back(detail::Package<W>{
-          .weight = W(first_package.weight + second_package.weight),
-          .indices = {}});
-      detail::Package<W> &merged_package = curr_packages.back();
-      merged_package.indices.insert(merged_package.indices.end(),
-                                    first_package.indices.begin(),
-                                    first_package.indices.end());
-      merged_package.indices.insert(merged_package.indices.end(),
-                                    second_package.indices.begin(),
-                                    second_package.indices.end());
-    }
-    curr_packages.insert(curr_packages.end(), packages_by_level.at(0).begin(),
-                         packages_by_level.at(0).end());
-    std::ranges::sort(curr_packages, detail::comparePackages<W>);
-  }
-  std::vector<detail::Package<W>> &packages_at_last_level =
-      packages_by_level.at(max_length - 1);
-  std::vector<std::vector<detail::Package<W>>> solution_by_level(max_length);
-  solution_by_level.at(max_length - 1) = {packages_at_last_level.begin(),
-                                          packages_at_last_level.begin() +
-                                              (2 * num_non_zero_weights) - 2};
-  for (std::uint8_t level = max_length - 1; level-- > 0;) {
-    std::uint16_t num_multi_item_packages_in_prev_layer = 0;
-    for (const auto &package : solution_by_level.at(level + 1)) {
-      if (package.indices.size() <= 1) {
-        continue;
-      }
-      num_multi_item_packages_in_prev_layer++;
-    };
-    solution_by_level.at(level) = {
-        packages_by_level.at(level).begin(),
-        packages_by_level.at(level).begin() +
-            (2 * num_multi_item_packages_in_prev_layer)};
-  }
-  for (std::uint8_t level = max_length; level-- > 0;) {
-    for (const auto &package : solution_by_level.at(level)) {
-      if (package.indices.size() > 1) {
-        continue;
-      }
-      lengths.at(package.indices.at(0))++;
-    }
+  const auto sorted_lengths = detail::package_merge_sorted(sorted, max_length);
+  for (std::uint16_t i = 0; i < sorted.size; ++i) {
+    lengths.at(sorted.symbols[i]) = sorted_lengths[i];
   }
   return lengths;
 }
@@ -4,8 +4,8 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <limits>
 #include <span>
-#include <vector>
 
 #include "types.hpp"
 
@@ -22,17 +22,21 @@ constexpr auto prefix_codes(std::span<const std::uint8_t, N> lengths)
     return {};
   }
 
+  // Codes are held in 16 bits, so no length can exceed 16.
+  constexpr std::size_t maximum_length =
+      std::numeric_limits<decltype(PrefixCode::bits)>::digits;
+
   // Step 1.
   auto max_length = *std::ranges::max_element(lengths);
-  std::vector<std::uint16_t> count_by_length(max_length + 1);
+  std::array<std::uint16_t, maximum_length + 1> count_by_length{};
   for (auto length : lengths) {
-    count_by_length[length]++;
+    count_by_length.at(length)++;
   }
 
   // Step 2.
   std::uint16_t code_bits = 0;
   count_by_length[0] = 0;
-  std::vector<std::uint16_t> next_code_bits(max_length + 1);
+  std::array<std::uint16_t, maximum_length + 1> next_code_bits{};
   for (auto bits = 1; bits < max_length + 1; ++bits) {
     code_bits =
         static_cast<std::uint16_t>(code_bits + count_by_length[bits - 1]) << 1U;
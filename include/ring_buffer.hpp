@@ -7,7 +7,11 @@
 
 template <typename T, std::size_t Capacity> class RingBuffer {
 private:
-  std::array<T, Capacity> buffer_{};
+  // Elements are only read once they have been enqueued, so the buffer is
+  // left uninitialized rather than zeroed up front, which for the look-back
+  // buffers of the tokenizer would dominate the cost of compressing a small
+  // input. The pages of a large buffer are only touched as it fills.
+  std::array<T, Capacity> buffer_; // NOLINT (*-member-init)
   std::size_t size_{};
   std::size_t head_{}; // Index of the next element to be read from the queue
   std::size_t tail_{}; // Index where the next element will be written
@@ -105,6 +109,12 @@ public:
 
   auto peek() const -> const T & { return (*this)[0]; }
 
+  auto clear() -> void {
+    size_ = 0;
+    head_ = 0;
+    tail_ = 0;
+  }
+
   [[nodiscard]] auto operator[](std::size_t ind) const -> const T & {
     if (ind >= size_) {
       throw std::out_of_range(
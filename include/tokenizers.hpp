@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "constants.hpp"
+#include "ring_buffer.hpp"
+#include "types.hpp"
+
+// Tokenizers that stand in for Lzss in a block stream, with the same
+// interface, for the strategies that do not search the look-back buffer.
+// Neither keeps any hash state, so both run far faster than Lzss, and suit
+// inputs whose repeats are mostly runs of a byte, or that have none at all.
+
+// LiteralTokenizer tokenizes its input into literals only, so that a block is
+// compressed with its prefix codes alone (zlib's Z_HUFFMAN_ONLY).
+class LiteralTokenizer {
+private:
+  std::uint8_t literal_{};
+  bool is_empty_ = true;
+
+public:
+  [[nodiscard]] auto is_empty() const -> bool { return is_empty_; }
+
+  // A literal is taken as soon as it is put, so there is no look-ahead.
+  [[nodiscard]] auto is_full() const -> bool { return !is_empty_; }
+
+  [[nodiscard]] auto literal() const -> std::uint8_t { return literal_; }
+
+  static auto back_reference() -> BackReference {
+    return BackReference{.distance = 0, .length = 0};
+  }
+
+  static auto take_back_reference() {}
+
+  auto take_literal() { is_empty_ = true; }
+
+  auto put(std::uint8_t literal) {
+    literal_ = literal;
+    is_empty_ = false;
+  }
+
+  static auto clear_look_back() {}
+};
+
+// RunLengthTokenizer tokenizes runs of a byte into back references with a
+// distance of one, and everything else into literals (zlib's Z_RLE). Only the
+// previous byte is kept in place of the look-back buffer.
+template <std::size_t LookAheadSize = maximum_look_ahead_size>
+class RunLengthTokenizer {
+private:
+  RingBuffer<std::uint8_t, LookAheadSize> look_ahead_;
+  std::uint8_t previous_{};
+  bool has_previous_ = false;
+
+public:
+  [[nodiscard]] auto is_empty() const -> bool { return look_ahead_.is_empty(); }
+
+  [[nodiscard]] auto is_full() const -> bool { return look_ahead_.is_full(); }
+
+  [[nodiscard]] auto literal() const -> std::uint8_t {
+    return look_ahead_.peek();
+  }
+
+  // Return the run of the previous byte at the start of the look-ahead, or an
+  // empty back reference if the run is too short to be one.
+  [[nodiscard]] auto back_reference() const -> BackReference {
+    std::size_t length = 0;
+    if (has_previous_) {
+      while (length < look_ahead_.size() && look_ahead_[length] == previous_) {
+        ++length;
+      }
+    }
+    if (length < minimum_back_reference_length) {
+      return BackReference{.distance = 0, .length = 0};
+    }
+    return BackReference{.distance = 1, .length = length};
+  }
+
+  auto take_back_reference() {
+    for (auto length = back_reference().length; length > 0; --length) {
+      take_literal();
+    }
+  }
+
+  auto take_literal() {
+    previous_ = look_ahead_.dequeue();
+    has_previous_ = true;
+  }
+
+  auto put(std::uint8_t literal) { look_ahead_.enqueue(literal); }
+
+  // Forget the previous byte, so that no run continues from the bytes taken
+  // so far.
+  auto clear_look_back() { has_previous_ = false; }
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <bit>
 #include <cstddef>
 #include <cstdint>
 #include <utility>
@@ -17,14 +18,21 @@ struct PrefixCode {
   std::uint8_t length;
 };
 
-struct PrefixCodeWithOffset {
-  PrefixCode prefix_code;
-  Offset offset;
-};
+// A code word in the order it is written to the bit stream (least significant
+// bit first): a prefix code with its bits reversed, optionally followed by the
+// bits of an offset, so that it can be written at once.
+struct CodeWord {
+  std::uint32_t bits;
+  std::uint8_t length;
 
-struct PrefixCodedBackReference {
-  PrefixCodeWithOffset length;
-  PrefixCodeWithOffset distance;
+  static constexpr auto from_prefix_code(PrefixCode prefix_code) -> CodeWord;
+
+  [[nodiscard]] constexpr auto with_offset(Offset offset) const -> CodeWord {
+    return CodeWord{.bits = bits | (static_cast<std::uint32_t>(offset.bits)
+                                    << length),
+                    .length = static_cast<std::uint8_t>(length +
+                                                        offset.num_bits)};
+  }
 };
 
 struct BackReference {
@@ -36,7 +44,7 @@ struct SymbolWithOffset {
   std::uint16_t symbol;
   Offset offset;
   static constexpr auto from_distance(std::uint16_t distance)
-      -> const SymbolWithOffset &;
+      -> SymbolWithOffset;
   static constexpr auto from_length(std::uint16_t length)
       -> const SymbolWithOffset &;
   static constexpr auto to_length(SymbolWithOffset symbol_with_offset)
@@ -69,47 +77,40 @@ get_symbols_with_offsets_from_ranges(const std::array<Range, R> ranges)
   return symbols_with_offsets;
 }
 
-constexpr auto get_symbol_with_offset_by_distance()
-    -> std::array<SymbolWithOffset, maximum_look_back_size + 1> {
-  return get_symbols_with_offsets_from_ranges<num_distance_symbols,
-                                              maximum_look_back_size + 1>({
-      // NOLINTBEGIN (cppcoreguidelines-avoid-magic-numbers)
-      Range{.symbol = 0, .num_offset_bits = 0, .start = 1, .end = 1},
-      Range{.symbol = 1, .num_offset_bits = 0, .start = 2, .end = 2},
-      Range{.symbol = 2, .num_offset_bits = 0, .start = 3, .end = 3},
-      Range{.symbol = 3, .num_offset_bits = 0, .start = 4, .end = 4},
-      Range{.symbol = 4, .num_offset_bits = 1, .start = 5, .end = 6},
-      Range{.symbol = 5, .num_offset_bits = 1, .start = 7, .end = 8},
-      Range{.symbol = 6, .num_offset_bits = 2, .start = 9, .end = 12},
-      Range{.symbol = 7, .num_offset_bits = 2, .start = 13, .end = 16},
-      Range{.symbol = 8, .num_offset_bits = 3, .start = 17, .end = 24},
-      Range{.symbol = 9, .num_offset_bits = 3, .start = 25, .end = 32},
-      Range{.symbol = 10, .num_offset_bits = 4, .start = 33, .end = 48},
-      Range{.symbol = 11, .num_offset_bits = 4, .start = 49, .end = 64},
-      Range{.symbol = 12, .num_offset_bits = 5, .start = 65, .end = 96},
-      Range{.symbol = 13, .num_offset_bits = 5, .start = 97, .end = 128},
-      Range{.symbol = 14, .num_offset_bits = 6, .start = 129, .end = 192},
-      Range{.symbol = 15, .num_offset_bits = 6, .start = 193, .end = 256},
-      Range{.symbol = 16, .num_offset_bits = 7, .start = 257, .end = 384},
-      Range{.symbol = 17, .num_offset_bits = 7, .start = 385, .end = 512},
-      Range{.symbol = 18, .num_offset_bits = 8, .start = 513, .end = 768},
-      Range{.symbol = 19, .num_offset_bits = 8, .start = 769, .end = 1024},
-      Range{.symbol = 20, .num_offset_bits = 9, .start = 1025, .end = 1536},
-      Range{.symbol = 21, .num_offset_bits = 9, .start = 1537, .end = 2048},
-      Range{.symbol = 22, .num_offset_bits = 10, .start = 2049, .end = 3072},
-      Range{.symbol = 23, .num_offset_bits = 10, .start = 3073, .end = 4096},
-      Range{.symbol = 24, .num_offset_bits = 11, .start = 4097, .end = 6144},
-      Range{.symbol = 25, .num_offset_bits = 11, .start = 6145, .end = 8192},
-      Range{.symbol = 26, .num_offset_bits = 12, .start = 8193, .end = 12288},
-      Range{.symbol = 27, .num_offset_bits = 12, .start = 12289, .end = 16384},
-      Range{.symbol = 28, .num_offset_bits = 13, .start = 16385, .end = 24576},
-      Range{.symbol = 29, .num_offset_bits = 13, .start = 24577, .end = 32768},
-      // NOLINTEND (cppcoreguidelines-avoid-magic-numbers)
-  });
-}
-
-constexpr std::array<SymbolWithOffset, maximum_look_back_size + 1>
-    symbol_with_offset_by_distance{get_symbol_with_offset_by_distance()};
+constexpr auto distance_ranges = std::array<Range, num_distance_symbols>{
+    // NOLINTBEGIN (cppcoreguidelines-avoid-magic-numbers)
+    Range{.symbol = 0, .num_offset_bits = 0, .start = 1, .end = 1},
+    Range{.symbol = 1, .num_offset_bits = 0, .start = 2, .end = 2},
+    Range{.symbol = 2, .num_offset_bits = 0, .start = 3, .end = 3},
+    Range{.symbol = 3, .num_offset_bits = 0, .start = 4, .end = 4},
+    Range{.symbol = 4, .num_offset_bits = 1, .start = 5, .end = 6},
+    Range{.symbol = 5, .num_offset_bits = 1, .start = 7, .end = 8},
+    Range{.symbol = 6, .num_offset_bits = 2, .start = 9, .end = 12},
+    Range{.symbol = 7, .num_offset_bits = 2, .start = 13, .end = 16},
+    Range{.symbol = 8, .num_offset_bits = 3, .start = 17, .end = 24},
+    Range{.symbol = 9, .num_offset_bits = 3, .start = 25, .end = 32},
+    Range{.symbol = 10, .num_offset_bits = 4, .start = 33, .end = 48},
+    Range{.symbol = 11, .num_offset_bits = 4, .start = 49, .end = 64},
+    Range{.symbol = 12, .num_offset_bits = 5, .start = 65, .end = 96},
+    Range{.symbol = 13, .num_offset_bits = 5, .start = 97, .end = 128},
+    Range{.symbol = 14, .num_offset_bits = 6, .start = 129, .end = 192},
+    Range{.symbol = 15, .num_offset_bits = 6, .start = 193, .end = 256},
+    Range{.symbol = 16, .num_offset_bits = 7, .start = 257, .end = 384},
+    Range{.symbol = 17, .num_offset_bits = 7, .start = 385, .end = 512},
+    Range{.symbol = 18, .num_offset_bits = 8, .start = 513, .end = 768},
+    Range{.symbol = 19, .num_offset_bits = 8, .start = 769, .end = 1024},
+    Range{.symbol = 20, .num_offset_bits = 9, .start = 1025, .end = 1536},
+    Range{.symbol = 21, .num_offset_bits = 9, .start = 1537, .end = 2048},
+    Range{.symbol = 22, .num_offset_bits = 10, .start = 2049, .end = 3072},
+    Range{.symbol = 23, .num_offset_bits = 10, .start = 3073, .end = 4096},
+    Range{.symbol = 24, .num_offset_bits = 11, .start = 4097, .end = 6144},
+    Range{.symbol = 25, .num_offset_bits = 11, .start = 6145, .end = 8192},
+    Range{.symbol = 26, .num_offset_bits = 12, .start = 8193, .end = 12288},
+    Range{.symbol = 27, .num_offset_bits = 12, .start = 12289, .end = 16384},
+    Range{.symbol = 28, .num_offset_bits = 13, .start = 16385, .end = 24576},
+    Range{.symbol = 29, .num_offset_bits = 13, .start = 24577, .end = 32768},
+    // NOLINTEND (cppcoreguidelines-avoid-magic-numbers)
+};
 
 constexpr auto length_ranges = std::array<Range, num_length_symbols>{
     // NOLINTBEGIN (cppcoreguidelines-avoid-magic-numbers)
@@ -167,11 +168,51 @@ constexpr auto get_length_starts_by_symbol()
 constexpr std::array<std::uint16_t, num_length_symbols> length_starts_by_symbol{
     get_length_starts_by_symbol()};
 
+constexpr auto get_num_offset_bits_by_symbol()
+    -> std::array<std::uint8_t,
+                  num_literal_length_symbols + num_distance_symbols> {
+  std::array<std::uint8_t, num_literal_length_symbols + num_distance_symbols>
+      num_offset_bits_by_symbol{};
+  for (const auto &range : length_ranges) {
+    num_offset_bits_by_symbol.at(range.symbol) = range.num_offset_bits;
+  }
+  for (const auto &range : distance_ranges) {
+    num_offset_bits_by_symbol.at(num_literal_length_symbols + range.symbol) =
+        range.num_offset_bits;
+  }
+  return num_offset_bits_by_symbol;
+}
+
 } // namespace detail
 
+constexpr auto CodeWord::from_prefix_code(PrefixCode prefix_code) -> CodeWord {
+  std::uint32_t reversed = 0;
+  for (std::uint8_t i = 0; i < prefix_code.length; ++i) {
+    reversed = (reversed << 1U) | ((prefix_code.bits >> i) & 1U);
+  }
+  return CodeWord{.bits = reversed, .length = prefix_code.length};
+}
+
+// Distance symbols are computed from the position of the highest set bit of
+// the distance rather than looked up in a table with an entry per distance,
+// which would compete with the match finder for cache. Above distance 4, each
+// pair of symbols covers a power of two, the symbol's low bit is the bit below
+// the highest set bit, and the offset is the bits below that.
+//
+// References:
+// https://www.ietf.org/rfc/rfc1951.txt (Section 3.2.5)
 constexpr auto SymbolWithOffset::from_distance(std::uint16_t distance)
-    -> const SymbolWithOffset & {
-  return detail::symbol_with_offset_by_distance.at(distance);
+    -> SymbolWithOffset {
+  const std::uint32_t index = distance - 1U;
+  const auto highest_bit =
+      static_cast<std::uint32_t>(std::bit_width(index | 1U)) - 1U;
+  const auto num_offset_bits = highest_bit - (highest_bit > 0 ? 1U : 0U);
+  return SymbolWithOffset{
+      .symbol = static_cast<std::uint16_t>((2 * highest_bit) +
+                                           ((index >> num_offset_bits) & 1U)),
+      .offset = Offset{.bits = static_cast<std::uint16_t>(
+                           index & ((1U << num_offset_bits) - 1U)),
+                       .num_bits = static_cast<std::uint8_t>(num_offset_bits)}};
 }
 
 constexpr auto SymbolWithOffset::from_length(std::uint16_t length)
@@ -185,3 +226,9 @@ constexpr auto SymbolWithOffset::to_length(SymbolWithOffset symbol_with_offset)
              symbol_with_offset.symbol - detail::length_ranges.at(0).symbol) +
          symbol_with_offset.offset.bits;
 }
+
+// The number of offset bits that follow each literal/length symbol, and each
+// distance symbol (offset by num_literal_length_symbols).
+constexpr std::array<std::uint8_t,
+                     num_literal_length_symbols + num_distance_symbols>
+    num_offset_bits_by_symbol{detail::get_num_offset_bits_by_symbol()};
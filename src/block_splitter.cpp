@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "block_splitter.hpp"
+#include "constants.hpp"
+#include "types.hpp"
+
+namespace {
+
+// Header bits that do not depend on the symbol counts: the last block flag
+// and block type (3 bits), HLIT, HDIST and HCLEN (14 bits), and a typical
+// number of code length code lengths (16 codes, 3 bits each).
+constexpr double fixed_header_bits = 3 + 14 + (16 * 3);
+// Typical cost of a code length symbol for a used symbol.
+constexpr double used_symbol_header_bits = 4;
+// Typical cost of a run of zero code lengths using code length symbols 17
+// (3 to 10 zeros, 3 offset bits) and 18 (11 to 138 zeros, 7 offset bits).
+constexpr double short_zero_run_header_bits = 4 + 3;
+constexpr double long_zero_run_header_bits = 4 + 7;
+constexpr std::size_t maximum_long_zero_run = 138;
+constexpr std::size_t minimum_long_zero_run = 11;
+constexpr std::size_t minimum_short_zero_run = 3;
+
+auto estimate_zero_run_header_bits(std::size_t run) -> double {
+  double bits = 0;
+  while (run >= minimum_long_zero_run) {
+    bits += long_zero_run_header_bits;
+    run -= std::min(run, maximum_long_zero_run);
+  }
+  if (run >= minimum_short_zero_run) {
+    return bits + short_zero_run_header_bits;
+  }
+  return bits + (static_cast<double>(run) * used_symbol_header_bits);
+}
+
+// Estimate the bits to encode the symbols of one alphabet (and their code
+// lengths in the header), using the entropy of the symbols as the length of
+// their prefix codes. Every used symbol costs at least one bit, as no prefix
+// code is shorter.
+auto estimate_alphabet_bits(std::span<const std::uint32_t> begin,
+                            std::span<const std::uint32_t> end,
+                            std::size_t first_symbol,
+                            std::size_t minimum_num_code_lengths,
+                            std::uint32_t num_extra_symbols) -> double {
+  std::uint64_t total = num_extra_symbols;
+  std::size_t num_code_lengths = minimum_num_code_lengths;
+  for (std::size_t i = 0; i < begin.size(); ++i) {
+    const auto count = end[i] - begin[i];
+    total += count;
+    if (count > 0) {
+      num_code_lengths = std::max(num_code_lengths, i + 1);
+    }
+  }
+  if (total == 0) {
+    return estimate_zero_run_header_bits(num_code_lengths);
+  }
+
+  const auto log2_total = std::log2(static_cast<double>(total));
+  double bits = 0;
+  std::size_t zero_run = 0;
+  for (std::size_t i = 0; i < num_code_lengths; ++i) {
+    const auto count = end[i] - begin[i];
+    if (count == 0) {
+      zero_run++;
+      continue;
+    }
+    bits += estimate_zero_run_header_bits(zero_run) + used_symbol_header_bits;
+    zero_run = 0;
+    const auto code_bits =
+        std::max(1.0, log2_total - std::log2(static_cast<double>(count)));
+    bits += count *
+            (code_bits + num_offset_bits_by_symbol.at(first_symbol + i));
+  }
+  bits += estimate_zero_run_header_bits(zero_run);
+  if (num_extra_symbols > 0) {
+    bits += num_extra_symbols *
+            std::max(1.0, log2_total - std::log2(num_extra_symbols));
+  }
+  return bits;
+}
+
+} // namespace
+
+auto block_splitter::estimate_bits(const Counts &begin, const Counts &end)
+    -> double {
+  constexpr std::size_t minimum_num_literal_length_code_lengths =
+      eob_symbol + 1;
+  constexpr std::size_t minimum_num_distance_code_lengths = 1;
+  const std::span<const std::uint32_t> begin_span(begin);
+  const std::span<const std::uint32_t> end_span(end);
+  // The end-of-block symbol is not counted, but appears once in every block.
+  return fixed_header_bits +
+         estimate_alphabet_bits(
+             begin_span.first(num_literal_length_symbols),
+             end_span.first(num_literal_length_symbols), 0,
+             minimum_num_literal_length_code_lengths, 1) +
+         estimate_alphabet_bits(begin_span.subspan(num_literal_length_symbols),
+                                end_span.subspan(num_literal_length_symbols),
+                                num_literal_length_symbols,
+                                minimum_num_distance_code_lengths, 0);
+}
+
+auto block_splitter::split(std::span<const Counts> cumulative_counts)
+    -> std::vector<std::size_t> {
+  const auto boundaries =
+      split(cumulative_counts, *std::pmr::get_default_resource());
+  return {boundaries.begin(), boundaries.end()};
+}
+
+auto block_splitter::split(std::span<const Counts> cumulative_counts,
+                           std::pmr::memory_resource &resource)
+    -> std::pmr::vector<std::size_t> {
+  std::pmr::vector<std::size_t> boundaries(1, 0, &resource);
+  if (cumulative_counts.size() < 2) {
+    return boundaries;
+  }
+
+  auto estimate = [&cumulative_counts](std::size_t begin, std::size_t end) {
+    return estimate_bits(cumulative_counts[begin], cumulative_counts[end]);
+  };
+
+  // Split recursively, trying every candidate boundary within each block.
+  std::pmr::vector<std::pair<std::size_t, std::size_t>> unsplit_blocks(
+      1, {0, cumulative_counts.size() - 1}, &resource);
+  while (!unsplit_blocks.empty()) {
+    const auto [begin, end] = unsplit_blocks.back();
+    unsplit_blocks.pop_back();
+    auto best_bits = estimate(begin, end);
+    auto best_boundary = begin;
+    for (auto boundary = begin + 1; boundary < end; ++boundary) {
+      const auto bits = estimate(begin, boundary) + estimate(boundary, end);
+      if (bits < best_bits) {
+        best_bits = bits;
+        best_boundary = boundary;
+      }
+    }
+    if (best_boundary == begin) {
+      boundaries.push_back(end);
+      continue;
+    }
+    // Visit the first half before the second so that boundaries are added in
+    // order.
+    unsplit_blocks.emplace_back(best_boundary, end);
+    unsplit_blocks.emplace_back(begin, best_boundary);
+  }
+
+  // Merge adjacent blocks that are cheaper together, e.g. when later splits
+  // have left a block with a neighbour that shares its statistics.
+  bool is_merged = true;
+  while (is_merged && boundaries.size() > 2) {
+    is_merged = false;
+    for (std::size_t i = 1; i + 1 < boundaries.size(); ++i) {
+      const auto separate_bits = estimate(boundaries[i - 1], boundaries[i]) +
+                                 estimate(boundaries[i], boundaries[i + 1]);
+      if (estimate(boundaries[i - 1], boundaries[i + 1]) <= separate_bits) {
+        boundaries.erase(boundaries.begin() + static_cast<std::ptrdiff_t>(i));
+        is_merged = true;
+        break;
+      }
+    }
+  }
+
+  return boundaries;
+}
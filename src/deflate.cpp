@@ -1,5 +1,5 @@
-#include <cstddef>
 #include <cstdint>
+#include <span>
 
 #include "deflate.hpp"
 #include "gz.hpp"
@@ -9,16 +9,8 @@ auto deflate::BitStreamMixin::push_prefix_code(PrefixCode prefix_code) -> void {
   push_symbolic_bits(prefix_code.bits, prefix_code.length);
 }
 
-auto deflate::BitStreamMixin::push_offset(Offset offset) -> void {
-  push_bits(offset.bits, offset.num_bits);
-}
-
-auto deflate::BitStreamMixin::push_back_reference(
-    PrefixCodedBackReference prefix_coded_back_reference) -> void {
-  push_prefix_code(prefix_coded_back_reference.length.prefix_code);
-  push_offset(prefix_coded_back_reference.length.offset);
-  push_prefix_code(prefix_coded_back_reference.distance.prefix_code);
-  push_offset(prefix_coded_back_reference.distance.offset);
+auto deflate::BitStreamMixin::push_code_word(CodeWord code_word) -> void {
+  push_word(code_word.bits, code_word.length);
 }
 
 deflate::BitStream::BitStream(gz::BitStream &bit_stream)
@@ -28,26 +20,14 @@ auto deflate::BitStream::push_bit(std::uint8_t b) -> void {
   wrapped_.push_bit(b);
 }
 
-auto deflate::BitStream::flush_byte() -> void { wrapped_.flush_byte(); }
-
-deflate::BufferedBitStream::BufferedBitStream(gz::BitStream &bit_stream)
-    : wrapped_(gz::BufferedBitStream(bit_stream)),
-      unbuffered_(BitStream(bit_stream)) {}
-
-auto deflate::BufferedBitStream::push_bit(std::uint8_t b) -> void {
-  wrapped_.push_bit(b);
+auto deflate::BitStream::push_word(std::uint32_t b, std::uint8_t num_bits)
+    -> void {
+  wrapped_.push_word(b, num_bits);
 }
 
-auto deflate::BufferedBitStream::flush_byte() -> void { wrapped_.flush_byte(); }
-
-auto deflate::BufferedBitStream::bits() const -> std::size_t {
-  return wrapped_.bits();
+auto deflate::BitStream::push_bytes(std::span<const std::uint8_t> bytes)
+    -> void {
+  wrapped_.push_bytes(bytes);
 }
 
-auto deflate::BufferedBitStream::commit() -> void { wrapped_.commit(); }
-
-auto deflate::BufferedBitStream::reset() -> void { wrapped_.reset(); }
-
-auto deflate::BufferedBitStream::unbuffered() -> BitStream & {
-  return unbuffered_;
-}
+auto deflate::BitStream::flush_byte() -> void { wrapped_.flush_byte(); }
@@ -1,6 +1,7 @@
-#include <cstddef>
 #include <cstdint>
+#include <ios>
 #include <ostream>
+#include <span>
 
 #include "gz.hpp"
 #include "size.hpp"
@@ -37,53 +38,35 @@ auto gz::BitStream::push_bit(std::uint8_t b) -> void {
   }
 }
 
-auto gz::BitStream::flush_byte() -> void {
-  if (num_bits_ == 0) {
-    return;
+auto gz::BitStream::push_word(std::uint32_t b, std::uint8_t num_bits)
+    -> void {
+  constexpr auto bits_per_byte = size_of_in_bits<std::uint8_t>();
+  auto pending = static_cast<std::uint64_t>(bits_) |
+                 (static_cast<std::uint64_t>(b) << num_bits_);
+  auto num_pending_bits = static_cast<std::uint8_t>(num_bits_ + num_bits);
+  while (num_pending_bits >= bits_per_byte) {
+    out_.put(static_cast<char>(pending));
+    pending >>= bits_per_byte;
+    num_pending_bits -= bits_per_byte;
   }
-  out_.put(static_cast<char>(bits_));
-  bits_ = 0;
-  num_bits_ = 0;
+  bits_ = static_cast<std::uint8_t>(pending);
+  num_bits_ = num_pending_bits;
 }
 
-gz::BufferedBitStream::BufferedBitStream(BitStream &bit_stream)
-    : bits_(0), num_bits_(0), wrapped_(bit_stream) {}
-
-auto gz::BufferedBitStream::push_bit(std::uint8_t b) -> void {
-  bits_ |= (b & 1U) << num_bits_;
-  num_bits_++;
-  if (num_bits_ == size_of_in_bits(bits_)) {
-    flush_byte();
+auto gz::BitStream::push_bytes(std::span<const std::uint8_t> bytes) -> void {
+  if (num_bits_ != 0) {
+    BitStreamMixin::push_bytes(bytes);
+    return;
   }
+  out_.write(reinterpret_cast<const char *>(bytes.data()),
+             static_cast<std::streamsize>(bytes.size()));
 }
 
-auto gz::BufferedBitStream::flush_byte() -> void {
+auto gz::BitStream::flush_byte() -> void {
   if (num_bits_ == 0) {
     return;
   }
-  buffer_.emplace_back(bits_);
-  bits_ = 0;
-  num_bits_ = 0;
-}
-
-auto gz::BufferedBitStream::bits() const -> std::size_t {
-  return (buffer_.size() * size_of_in_bits<decltype(buffer_)::value_type>()) +
-         num_bits_;
-}
-
-auto gz::BufferedBitStream::commit() -> void {
-  for (const auto &byte : buffer_) {
-    wrapped_.push(byte);
-  }
-  if (num_bits_ > 0) {
-    wrapped_.push_bits(bits_, num_bits_);
-  }
-}
-
-auto gz::BufferedBitStream::reset() -> void {
-  buffer_.clear();
+  out_.put(static_cast<char>(bits_));
   bits_ = 0;
   num_bits_ = 0;
 }
-
-auto gz::BufferedBitStream::unbuffered() -> BitStream & { return wrapped_; }
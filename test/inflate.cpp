@@ -0,0 +1,40 @@
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include "inflate.hpp"
+
+auto inflate_with_zlib(const std::string &compressed, bool is_gz)
+    -> std::optional<std::vector<std::uint8_t>> {
+  z_stream stream{};
+  constexpr int window_bits = 15;
+  constexpr int gz_window_bits = 16 + window_bits;
+  if (inflateInit2(&stream, is_gz ? gz_window_bits : -window_bits) != Z_OK) {
+    return std::nullopt;
+  }
+  // NOLINTNEXTLINE (cppcoreguidelines-pro-type-const-cast)
+  stream.next_in =
+      reinterpret_cast<Bytef *>(const_cast<char *>(compressed.data()));
+  stream.avail_in = static_cast<uInt>(compressed.size());
+  std::vector<std::uint8_t> decompressed;
+  std::array<std::uint8_t, 1U << 14U> chunk{};
+  int result = Z_OK;
+  while (result == Z_OK) {
+    stream.next_out = chunk.data();
+    stream.avail_out = static_cast<uInt>(chunk.size());
+    result = inflate(&stream, Z_SYNC_FLUSH);
+    decompressed.insert(decompressed.end(), chunk.data(),
+                        chunk.data() + (chunk.size() - stream.avail_out));
+  }
+  inflateEnd(&stream);
+  // Z_BUF_ERROR means that the input ran out before the end of the stream,
+  // which is expected for the output up to a flush.
+  if (result != Z_STREAM_END && result != Z_BUF_ERROR) {
+    return std::nullopt;
+  }
+  return decompressed;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Decode as much of a deflate stream (with a gz header if is_gz) as is
+// available with zlib, or return none if it is invalid, e.g. because a back
+// reference reaches before its start. zlib is kept out of this header, as its
+// deflate function clashes with the deflate namespace.
+auto inflate_with_zlib(const std::string &compressed, bool is_gz)
+    -> std::optional<std::vector<std::uint8_t>>;
@@ -0,0 +1,90 @@
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+
+#include "compressor.hpp"
+#include "options.hpp"
+
+// Measure the time to compress inputs crafted to make the match finder slow,
+// as could be uploaded by a malicious user: runs of a byte or of a short
+// period, random bytes over a tiny alphabet, which make every chain long, and
+// patterns that fall into one bucket of a hash map with the identity hash of
+// the standard library. Each should compress within a small factor of the
+// time for ordinary text (see lzss.hpp).
+
+namespace {
+
+constexpr std::size_t input_size = 1U << 18U;
+
+auto periodic(std::string_view period) -> std::vector<std::uint8_t> {
+  std::vector<std::uint8_t> bytes(input_size);
+  for (std::size_t i = 0; i < bytes.size(); ++i) {
+    bytes[i] = static_cast<std::uint8_t>(period[i % period.size()]);
+  }
+  return bytes;
+}
+
+auto random_over(std::string_view alphabet) -> std::vector<std::uint8_t> {
+  std::mt19937 generator(0);
+  std::uniform_int_distribution<std::size_t> letter(0, alphabet.size() - 1);
+  std::vector<std::uint8_t> bytes(input_size);
+  for (auto &byte : bytes) {
+    byte = static_cast<std::uint8_t>(alphabet[letter(generator)]);
+  }
+  return bytes;
+}
+
+// Random bytes to fill the hash map, followed by three-byte patterns that are
+// equal modulo the number of buckets that it then has.
+auto colliding_patterns() -> std::vector<std::uint8_t> {
+  constexpr std::size_t num_random_bytes = 1U << 16U;
+  std::vector<std::uint8_t> bytes(input_size);
+  std::mt19937 generator(0);
+  for (std::size_t i = 0; i < num_random_bytes; ++i) {
+    bytes[i] = static_cast<std::uint8_t>(generator());
+  }
+  std::unordered_map<std::uint32_t, std::uint64_t> patterns;
+  for (std::uint32_t pattern = 0; pattern < maximum_look_back_size;
+       ++pattern) {
+    patterns[pattern] = pattern;
+  }
+  const auto num_buckets = patterns.bucket_count();
+  std::size_t i = num_random_bytes;
+  for (std::uint32_t pattern = 0; i + 3 <= bytes.size();
+       pattern = (pattern + num_buckets) % (1U << 24U)) {
+    bytes[i++] = static_cast<std::uint8_t>(pattern >> 16U);
+    bytes[i++] = static_cast<std::uint8_t>(pattern >> 8U);
+    bytes[i++] = static_cast<std::uint8_t>(pattern);
+  }
+  return bytes;
+}
+
+} // namespace
+
+TEST_CASE("compressing adversarial inputs", "[adversarial-inputs]") {
+  const Options options;
+  std::ostringstream out;
+  const auto benchmark = [&options, &out](
+                             const std::string &name,
+                             const std::vector<std::uint8_t> &bytes) {
+    BENCHMARK(std::string(name)) {
+      out.str("");
+      Compressor compressor(out, options);
+      compressor.compress(bytes);
+      return out.tellp();
+    };
+  };
+  benchmark("all equal", periodic("a"));
+  benchmark("period 2", periodic("ab"));
+  benchmark("period 7", periodic("abcdefg"));
+  benchmark("random over 2 letters", random_over("ab"));
+  benchmark("random over 4 letters", random_over("acgt"));
+  benchmark("colliding patterns", colliding_patterns());
+}
@@ -0,0 +1,92 @@
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+
+#include "constants.hpp"
+#include "types.hpp"
+
+// Compare looking up distance symbols in a table with an entry per distance (as
+// was done before, 192 KiB) with computing them from the highest set bit of the
+// distance (no table). Between lookups, a working set the size of the match
+// finder's chain and look-back buffers is touched at random, as the match
+// finder does, so that the tables compete with it for cache. Each variant is
+// tagged so that it can be run alone under `perf stat` to compare cache misses
+// (see `make microbenchmark`).
+
+namespace {
+
+constexpr std::size_t num_distances = 1U << 16U;
+constexpr std::size_t working_set_size = 1U << 20U;
+
+const std::array<SymbolWithOffset, maximum_look_back_size + 1>
+    symbol_with_offset_by_distance =
+        detail::get_symbols_with_offsets_from_ranges<
+            num_distance_symbols, maximum_look_back_size + 1>(
+            detail::distance_ranges);
+
+// Distances are drawn log-uniformly, since short distances are far more
+// common than long ones.
+auto random_distances() -> std::vector<std::uint16_t> {
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<double> log_distance(
+      0, std::log2(maximum_look_back_size));
+  std::vector<std::uint16_t> distances(num_distances);
+  for (auto &distance : distances) {
+    distance = static_cast<std::uint16_t>(std::exp2(log_distance(generator)));
+  }
+  return distances;
+}
+
+auto random_working_set_indices() -> std::vector<std::uint32_t> {
+  std::mt19937 generator(7);
+  std::uniform_int_distribution<std::uint32_t> index(0, working_set_size - 1);
+  std::vector<std::uint32_t> indices(num_distances);
+  for (auto &i : indices) {
+    i = index(generator);
+  }
+  return indices;
+}
+
+template <typename Lookup>
+auto run(const std::vector<std::uint16_t> &distances,
+         const std::vector<std::uint32_t> &indices,
+         std::vector<std::uint8_t> &working_set, Lookup lookup)
+    -> std::uint64_t {
+  std::uint64_t sum = 0;
+  for (std::size_t i = 0; i < distances.size(); ++i) {
+    working_set[indices[i]]++;
+    const auto symbol_with_offset = lookup(distances[i]);
+    sum += symbol_with_offset.symbol + symbol_with_offset.offset.bits;
+  }
+  return sum;
+}
+
+} // namespace
+
+TEST_CASE("distance symbol lookup in a table per distance",
+          "[distance-symbols][per-distance]") {
+  const auto distances = random_distances();
+  const auto indices = random_working_set_indices();
+  std::vector<std::uint8_t> working_set(working_set_size);
+  BENCHMARK("table with an entry per distance") {
+    return run(distances, indices, working_set, [](std::uint16_t distance) {
+      return symbol_with_offset_by_distance[distance];
+    });
+  };
+}
+
+TEST_CASE("distance symbol computation", "[distance-symbols][bit-scan]") {
+  const auto distances = random_distances();
+  const auto indices = random_working_set_indices();
+  std::vector<std::uint8_t> working_set(working_set_size);
+  BENCHMARK("bit scan") {
+    return run(distances, indices, working_set, [](std::uint16_t distance) {
+      return SymbolWithOffset::from_distance(distance);
+    });
+  };
+}
@@ -0,0 +1,77 @@
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+
+#include "compressor.hpp"
+#include "options.hpp"
+
+// Measure the time to compress inputs that are mostly incompressible, as in
+// a tarball of media files, with incompressible regions stored as soon as they
+// are detected and with them compressed as the rest of the input.
+
+namespace {
+
+constexpr std::size_t input_size = 1U << 20U;
+
+auto read_file(const std::filesystem::path &path) -> std::vector<std::uint8_t> {
+  std::ifstream file(path, std::ios::binary);
+  return {std::istreambuf_iterator<char>(file),
+          std::istreambuf_iterator<char>()};
+}
+
+auto random_bytes(std::size_t size) -> std::vector<std::uint8_t> {
+  std::mt19937 generator(0);
+  std::vector<std::uint8_t> bytes(size);
+  for (auto &byte : bytes) {
+    byte = static_cast<std::uint8_t>(generator());
+  }
+  return bytes;
+}
+
+// Random bytes, interrupted every 256 KiB by 64 KiB of text.
+auto random_bytes_and_text() -> std::vector<std::uint8_t> {
+  constexpr std::size_t random_size = 1U << 18U;
+  constexpr std::size_t text_size = 1U << 16U;
+  const auto text = read_file(std::filesystem::path(CGZIP_DATA_DIR) /
+                              "calgary_corpus" / "book1");
+  const auto random = random_bytes(input_size);
+  std::vector<std::uint8_t> bytes;
+  for (std::size_t i = 0; bytes.size() < input_size; ++i) {
+    const auto random_begin = random.begin() + (i * random_size);
+    bytes.insert(bytes.end(), random_begin, random_begin + random_size);
+    const auto text_begin = text.begin() + (i * text_size);
+    bytes.insert(bytes.end(), text_begin, text_begin + text_size);
+  }
+  return bytes;
+}
+
+} // namespace
+
+TEST_CASE("compressing incompressible inputs", "[incompressible-inputs]") {
+  std::ostringstream out;
+  const auto benchmark = [&out](const std::string &name,
+                                const std::vector<std::uint8_t> &bytes) {
+    for (const auto incompressible_regions :
+         {IncompressibleRegions::store, IncompressibleRegions::compress}) {
+      const Options options{.incompressible_regions = incompressible_regions};
+      BENCHMARK(name + (incompressible_regions == IncompressibleRegions::store
+                            ? ", stored"
+                            : ", compressed")) {
+        out.str("");
+        Compressor compressor(out, options);
+        compressor.compress(bytes);
+        return out.tellp();
+      };
+    }
+  };
+  benchmark("random bytes", random_bytes(input_size));
+  benchmark("random bytes and text", random_bytes_and_text());
+}
@@ -0,0 +1,48 @@
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <span>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+
+#include "compressor.hpp"
+#include "options.hpp"
+
+// Measure the latency of compressing a whole input of 64 B to 16 KiB, as for
+// the bodies of RPCs, where the fixed costs of a compressor (making its block
+// streams, and planning and writing a single block) dominate. Inputs below
+// the warmup of the change point detector skip change point detection, as
+// their size is known.
+
+namespace {
+
+auto read_input() -> std::vector<std::uint8_t> {
+  std::ifstream file(std::filesystem::path(CGZIP_DATA_DIR) / "calgary_corpus" /
+                         "paper1",
+                     std::ios::binary);
+  return {std::istreambuf_iterator<char>(file),
+          std::istreambuf_iterator<char>()};
+}
+
+} // namespace
+
+TEST_CASE("compressing tiny inputs", "[tiny-inputs]") {
+  const auto input = read_input();
+  const Options options;
+  std::ostringstream out;
+  // NOLINTNEXTLINE (cppcoreguidelines-avoid-magic-numbers)
+  for (const std::size_t size : {64, 256, 1024, 4096, 16384}) {
+    const auto bytes = std::span(input).first(size);
+    BENCHMARK(std::to_string(size) + " bytes") {
+      out.str("");
+      Compressor compressor(out, options);
+      compressor.compress(bytes);
+      return out.tellp();
+    };
+  }
+}
@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <ostream>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+
+#include "arena.hpp"
+#include "block_type.hpp"
+#include "block_type_1.hpp"
+#include "block_type_2.hpp"
+#include "gz.hpp"
+
+namespace {
+
+// The number of heap allocations made through operator new, which is
+// replaced below (along with operator delete) for the whole test executable.
+std::size_t num_heap_allocations = 0;
+
+} // namespace
+
+auto operator new(std::size_t size) -> void * {
+  num_heap_allocations++;
+  // NOLINTNEXTLINE (cppcoreguidelines-no-malloc)
+  if (auto *pointer = std::malloc(size == 0 ? 1 : size)) {
+    return pointer;
+  }
+  throw std::bad_alloc();
+}
+
+// NOLINTNEXTLINE (cppcoreguidelines-no-malloc)
+auto operator delete(void *pointer) noexcept -> void { std::free(pointer); }
+
+auto operator delete(void *pointer, std::size_t /*size*/) noexcept -> void {
+  std::free(pointer); // NOLINT (cppcoreguidelines-no-malloc)
+}
+
+auto operator new(std::size_t size, std::align_val_t alignment) -> void * {
+  num_heap_allocations++;
+  const auto alignment_size = static_cast<std::size_t>(alignment);
+  // The size passed to aligned_alloc must be a multiple of the alignment.
+  const auto aligned_size =
+      (std::max<std::size_t>(size, 1) + alignment_size - 1) /
+      alignment_size * alignment_size;
+  if (auto *pointer = std::aligned_alloc(alignment_size, aligned_size)) {
+    return pointer;
+  }
+  throw std::bad_alloc();
+}
+
+auto operator delete(void *pointer, std::align_val_t /*alignment*/) noexcept
+    -> void {
+  std::free(pointer); // NOLINT (cppcoreguidelines-no-malloc)
+}
+
+auto operator delete(void *pointer, std::size_t /*size*/,
+                     std::align_val_t /*alignment*/) noexcept -> void {
+  std::free(pointer); // NOLINT (cppcoreguidelines-no-malloc)
+}
+
+namespace {
+
+constexpr std::size_t block_size = 1U << 16U;
+constexpr int num_warmup_blocks = 3;
+constexpr int num_measured_blocks = 3;
+
+auto read_block() -> std::vector<std::uint8_t> {
+  std::ifstream file(std::filesystem::path(CGZIP_DATA_DIR) / "calgary_corpus" /
+                         "book1",
+                     std::ios::binary);
+  std::vector<std::uint8_t> bytes{std::istreambuf_iterator<char>(file),
+                                  std::istreambuf_iterator<char>()};
+  bytes.resize(block_size);
+  return bytes;
+}
+
+// Compress the same block repeatedly, and return the number of heap
+// allocations made while compressing the blocks after the warmup blocks.
+auto count_steady_state_allocations(BlockStream &block_stream)
+    -> std::size_t {
+  const auto block = read_block();
+  std::size_t num_warmup_allocations = 0;
+  for (int i = 0; i < num_warmup_blocks + num_measured_blocks; ++i) {
+    if (i == num_warmup_blocks) {
+      num_warmup_allocations = num_heap_allocations;
+    }
+    for (const auto byte : block) {
+      block_stream.put(byte);
+    }
+    static_cast<void>(block_stream.bits(false));
+    block_stream.commit(false);
+    block_stream.reset();
+  }
+  return num_heap_allocations - num_warmup_allocations;
+}
+
+} // namespace
+
+TEST_CASE("arena") {
+  Arena arena(64);
+
+  SECTION("allocates aligned memory") {
+    static_cast<void>(arena.allocate(1, 1));
+    const auto *pointer = arena.allocate(8, 8);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(pointer) % 8 == 0);
+  }
+
+  SECTION("reuses its memory after a reset") {
+    const auto *first = arena.allocate(32);
+    arena.reset();
+    REQUIRE(arena.allocate(32) == first);
+  }
+
+  SECTION("coalesces its chunks on reset") {
+    for (int i = 0; i < 10; ++i) {
+      static_cast<void>(arena.allocate(48));
+    }
+    const auto capacity = arena.capacity();
+    arena.reset();
+    REQUIRE(arena.capacity() == capacity);
+    const auto num_allocations = num_heap_allocations;
+    for (int i = 0; i < 10; ++i) {
+      static_cast<void>(arena.allocate(48));
+    }
+    const auto num_arena_allocations = num_heap_allocations - num_allocations;
+    REQUIRE(num_arena_allocations == 0);
+  }
+
+  SECTION("trims its chunks after a much smaller block") {
+    static_cast<void>(arena.allocate(4096));
+    arena.reset();
+    REQUIRE(arena.capacity() >= 4096);
+    static_cast<void>(arena.allocate(32));
+    arena.reset();
+    REQUIRE(arena.capacity() == 64);
+  }
+
+  SECTION("keeps its chunks after a somewhat smaller block") {
+    static_cast<void>(arena.allocate(256));
+    arena.reset();
+    const auto capacity = arena.capacity();
+    static_cast<void>(arena.allocate(128));
+    arena.reset();
+    REQUIRE(arena.capacity() == capacity);
+  }
+
+  SECTION("frees its chunks on release") {
+    static_cast<void>(arena.allocate(4096));
+    arena.release();
+    REQUIRE(arena.capacity() == 0);
+    REQUIRE(arena.size() == 0);
+  }
+}
+
+TEST_CASE("free list") {
+  FreeList free_list;
+
+  SECTION("reuses deallocated blocks") {
+    auto *first = free_list.allocate(24, 8);
+    auto *second = free_list.allocate(24, 8);
+    REQUIRE(first != second);
+    free_list.deallocate(first, 24, 8);
+    REQUIRE(free_list.allocate(24, 8) == first);
+  }
+
+  SECTION("allocates other sizes from upstream") {
+    auto *block = free_list.allocate(24, 8);
+    const auto num_allocations = num_heap_allocations;
+    auto *buckets = free_list.allocate(1024, 8);
+    const auto num_upstream_allocations =
+        num_heap_allocations - num_allocations;
+    free_list.deallocate(buckets, 1024, 8);
+    REQUIRE(num_upstream_allocations == 1);
+    free_list.deallocate(block, 24, 8);
+  }
+}
+
+TEST_CASE("block streams do not allocate in the steady state") {
+  // Bytes written to a stream without a buffer are discarded.
+  std::ostream discarded(nullptr);
+  gz::BitStream bit_stream(discarded);
+
+  SECTION("block type 1") {
+    block_type_1::Stream<> block_stream(bit_stream);
+    REQUIRE(count_steady_state_allocations(block_stream) == 0);
+  }
+
+  SECTION("block type 2") {
+    block_type_2::Stream<> block_stream(bit_stream);
+    REQUIRE(count_steady_state_allocations(block_stream) == 0);
+  }
+
+  SECTION("block type 2 with block splitting") {
+    block_type_2::Stream<> block_stream(bit_stream, true);
+    REQUIRE(count_steady_state_allocations(block_stream) == 0);
+  }
+}
@@ -0,0 +1,79 @@
+#include <cstddef>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+
+#include "block_splitter.hpp"
+
+namespace {
+
+// Build cumulative counts for segments, where each segment adds count to
+// every symbol in [first_symbol, last_symbol].
+struct Segment {
+  std::size_t first_symbol;
+  std::size_t last_symbol;
+  std::uint32_t count;
+};
+
+auto cumulative_counts(const std::vector<Segment> &segments)
+    -> std::vector<block_splitter::Counts> {
+  std::vector<block_splitter::Counts> cumulative(1);
+  for (const auto &segment : segments) {
+    auto counts = cumulative.back();
+    for (auto symbol = segment.first_symbol; symbol <= segment.last_symbol;
+         ++symbol) {
+      counts.at(symbol) += segment.count;
+    }
+    cumulative.push_back(counts);
+  }
+  return cumulative;
+}
+
+} // namespace
+
+TEST_CASE("block splitter") {
+  const Segment letters{.first_symbol = 'a', .last_symbol = 'z', .count = 100};
+  const Segment digits{.first_symbol = '0', .last_symbol = '9', .count = 260};
+
+  SECTION("estimates more bits for more symbols") {
+    const auto cumulative = cumulative_counts({letters, letters});
+    REQUIRE(block_splitter::estimate_bits(cumulative.at(0),
+                                          cumulative.at(1)) <
+            block_splitter::estimate_bits(cumulative.at(0), cumulative.at(2)));
+  }
+
+  SECTION("estimates at least one bit per symbol") {
+    const auto cumulative =
+        cumulative_counts({{.first_symbol = 'a', .last_symbol = 'a',
+                            .count = 1000}});
+    REQUIRE(block_splitter::estimate_bits(cumulative.at(0),
+                                          cumulative.at(1)) >= 1000);
+  }
+
+  SECTION("does not split a block without candidate boundaries") {
+    const auto cumulative = cumulative_counts({});
+    REQUIRE(block_splitter::split(cumulative) ==
+            std::vector<std::size_t>{0});
+  }
+
+  SECTION("does not split homogeneous symbols") {
+    const auto cumulative =
+        cumulative_counts({letters, letters, letters, letters});
+    REQUIRE(block_splitter::split(cumulative) ==
+            std::vector<std::size_t>{0, 4});
+  }
+
+  SECTION("splits where the distribution of symbols changes") {
+    const auto cumulative = cumulative_counts(
+        {letters, letters, letters, digits, digits, digits, digits});
+    REQUIRE(block_splitter::split(cumulative) ==
+            std::vector<std::size_t>{0, 3, 7});
+  }
+
+  SECTION("splits around a change in the middle of a block") {
+    const auto cumulative = cumulative_counts(
+        {letters, letters, letters, digits, digits, letters, letters, letters});
+    REQUIRE(block_splitter::split(cumulative) ==
+            std::vector<std::size_t>{0, 3, 5, 8});
+  }
+}
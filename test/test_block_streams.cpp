@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+
+#include "block_type.hpp"
+#include "block_type_1.hpp"
+#include "block_type_2.hpp"
+#include "gz.hpp"
+#include "tokenizers.hpp"
+
+namespace {
+
+constexpr std::size_t maximum_input_size = 1U << 18U;
+
+auto read_file(const std::filesystem::path &path) -> std::vector<std::uint8_t> {
+  std::ifstream file(path, std::ios::binary);
+  std::vector<std::uint8_t> bytes{std::istreambuf_iterator<char>(file),
+                                  std::istreambuf_iterator<char>()};
+  bytes.resize(std::min(bytes.size(), maximum_input_size));
+  return bytes;
+}
+
+// Put the bytes of each data file into a block stream, and require that the
+// number of bits it reports is the number of bits it writes when committed.
+template <typename MakeBlockStream>
+auto require_exact_bits(MakeBlockStream make_block_stream) {
+  for (const auto &entry :
+       std::filesystem::recursive_directory_iterator(CGZIP_DATA_DIR)) {
+    if (!entry.is_regular_file()) {
+      continue;
+    }
+    INFO(entry.path());
+    std::ostringstream stream;
+    std::uint64_t bits = 0;
+    {
+      gz::BitStream bit_stream(stream);
+      const std::unique_ptr<BlockStream> block_stream =
+          make_block_stream(bit_stream);
+      for (const auto byte : read_file(entry.path())) {
+        block_stream->put(byte);
+      }
+      bits = block_stream->bits(true);
+      REQUIRE(bits == block_stream->bits(false));
+      block_stream->commit(true);
+    }
+    REQUIRE(stream.str().size() == (bits + 7) / 8);
+  }
+}
+
+} // namespace
+
+TEST_CASE("block streams report the number of bits they write") {
+  SECTION("block type 1") {
+    require_exact_bits([](gz::BitStream &bit_stream) {
+      return std::make_unique<block_type_1::Stream<>>(bit_stream);
+    });
+  }
+
+  SECTION("block type 2") {
+    require_exact_bits([](gz::BitStream &bit_stream) {
+      return std::make_unique<block_type_2::Stream<>>(bit_stream);
+    });
+  }
+
+  SECTION("block type 2 with block splitting") {
+    require_exact_bits([](gz::BitStream &bit_stream) {
+      return std::make_unique<block_type_2::Stream<>>(bit_stream, true);
+    });
+  }
+
+  SECTION("block type 2 with re-parsing") {
+    require_exact_bits([](gz::BitStream &bit_stream) {
+      return std::make_unique<block_type_2::Stream<>>(bit_stream, true, 2);
+    });
+  }
+
+  SECTION("block type 2 with literals only") {
+    require_exact_bits([](gz::BitStream &bit_stream) {
+      return std::make_unique<block_type_2::Stream<
+          maximum_look_back_size, maximum_look_ahead_size, LiteralTokenizer>>(
+          bit_stream);
+    });
+  }
+
+  SECTION("block type 2 with runs only") {
+    require_exact_bits([](gz::BitStream &bit_stream) {
+      return std::make_unique<
+          block_type_2::Stream<maximum_look_back_size, maximum_look_ahead_size,
+                               RunLengthTokenizer<>>>(bit_stream);
+    });
+  }
+
+  SECTION("block type 2 with a small window") {
+    require_exact_bits([](gz::BitStream &bit_stream) {
+      return std::make_unique<block_type_2::Stream<1U << 12U>>(bit_stream);
+    });
+  }
+}
+
+TEST_CASE("block streams report the memory used to buffer their block") {
+  std::ostringstream stream;
+  gz::BitStream bit_stream(stream);
+  block_type_2::Stream<> block_stream(bit_stream, true);
+  const auto bytes = read_file(std::filesystem::path(CGZIP_DATA_DIR) /
+                               "calgary_corpus" / "book1");
+  const auto memory = block_stream.memory();
+  for (const auto byte : bytes) {
+    block_stream.put(byte);
+  }
+  static_cast<void>(block_stream.bits(false));
+  // Every byte and token is buffered, along with the candidate boundaries.
+  REQUIRE(block_stream.memory() > memory + bytes.size());
+  block_stream.reset();
+  REQUIRE(block_stream.memory() == memory);
+}
+
+TEST_CASE("block type 2 encodes short blocks with the fixed prefix codes") {
+  constexpr std::size_t short_block_size = 64;
+  std::ostringstream stream;
+  std::uint64_t bits = 0;
+  {
+    gz::BitStream bit_stream(stream);
+    block_type_2::Stream<> block_stream(bit_stream);
+    auto bytes = read_file(std::filesystem::path(CGZIP_DATA_DIR) /
+                           "calgary_corpus" / "book1");
+    bytes.resize(short_block_size);
+    for (const auto byte : bytes) {
+      block_stream.put(byte);
+    }
+    bits = block_stream.bits(true);
+    block_stream.commit(true);
+  }
+  REQUIRE(stream.str().size() == (bits + 7) / 8);
+  // The block type follows the is last flag in the first byte.
+  const auto block_type =
+      (static_cast<std::uint8_t>(stream.str().front()) >> 1U) & 3U;
+  REQUIRE(block_type == 1);
+}
+
+TEST_CASE("re-parsing never grows a block of type 2") {
+  // Some of the back references in this file cost more than their literals
+  // once the prefix codes are known.
+  const auto bytes = read_file(std::filesystem::path(CGZIP_DATA_DIR) /
+                               "canterbury_corpus" / "cp.html");
+  const auto bits = [&bytes](std::uint8_t num_reparse_passes) {
+    std::ostringstream stream;
+    gz::BitStream bit_stream(stream);
+    block_type_2::Stream<> block_stream(bit_stream, false, num_reparse_passes);
+    for (const auto byte : bytes) {
+      block_stream.put(byte);
+    }
+    return block_stream.bits(true);
+  };
+  const auto num_bits = bits(0);
+  const auto num_reparsed_bits = bits(1);
+  REQUIRE(num_reparsed_bits < num_bits);
+  REQUIRE(bits(2) <= num_reparsed_bits);
+}
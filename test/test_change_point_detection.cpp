@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <random>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+
+#include "change_point_detection.hpp"
+
+namespace {
+
+constexpr CusumDistributionDetectorParams params{.warmup = 1U << 13U,
+                                                 .threshold = 1e3};
+
+auto read_file(const std::filesystem::path &path) -> std::vector<std::uint8_t> {
+  std::ifstream file(path, std::ios::binary);
+  return {std::istreambuf_iterator<char>(file),
+          std::istreambuf_iterator<char>()};
+}
+
+} // namespace
+
+TEST_CASE("fixed-point log2") {
+  SECTION("is exact for powers of two") {
+    for (std::uint8_t i = 0; i < 32; ++i) {
+      REQUIRE(detail::fixed_log2(1U << i) ==
+              (static_cast<std::int32_t>(i) << detail::log2_fraction_bits));
+    }
+  }
+
+  SECTION("is close to log2") {
+    constexpr double scale = 1U << detail::log2_fraction_bits;
+    for (std::uint32_t x = 1; x < (1U << 20U); x += 97) {
+      REQUIRE_THAT(detail::fixed_log2(x) / scale,
+                   Catch::Matchers::WithinAbs(std::log2(x), 1e-4));
+    }
+  }
+}
+
+TEST_CASE("fixed-point cusum detector agrees with floating-point detector") {
+  // Change points cascade (each one restarts the warmup), so the detectors
+  // are resynchronized after both have reported a change point, and each
+  // pair of change points is compared independently.
+  constexpr std::size_t tolerance = 512;
+
+  for (const auto &entry :
+       std::filesystem::recursive_directory_iterator(CGZIP_DATA_DIR)) {
+    if (!entry.is_regular_file()) {
+      continue;
+    }
+    INFO(entry.path());
+    const auto bytes = read_file(entry.path());
+
+    CusumDistributionDetector floating_point_detector(params);
+    FixedPointCusumDistributionDetector fixed_point_detector(params);
+    std::optional<std::size_t> floating_point_change_point;
+    std::optional<std::size_t> fixed_point_change_point;
+
+    for (std::size_t i = 0; i < bytes.size(); ++i) {
+      if (floating_point_detector.step(bytes[i]) &&
+          !floating_point_change_point) {
+        floating_point_change_point = i;
+      }
+      if (fixed_point_detector.step(bytes[i]) && !fixed_point_change_point) {
+        fixed_point_change_point = i;
+      }
+      if (floating_point_change_point && fixed_point_change_point) {
+        // Compare the optionals themselves, as dereferencing them here is
+        // mistaken for a read of an uninitialized value by -Wall at -O2.
+        REQUIRE(floating_point_change_point <=
+                fixed_point_change_point.transform(
+                    [](std::size_t i) { return i + tolerance; }));
+        REQUIRE(fixed_point_change_point <=
+                floating_point_change_point.transform(
+                    [](std::size_t i) { return i + tolerance; }));
+        floating_point_detector.reset();
+        fixed_point_detector.reset();
+        floating_point_change_point.reset();
+        fixed_point_change_point.reset();
+      }
+    }
+
+    // A change point from one detector must be matched by the other.
+    REQUIRE(floating_point_change_point.has_value() ==
+            fixed_point_change_point.has_value());
+  }
+}
+
+TEMPLATE_TEST_CASE("cusum detectors estimate the location of a change", "",
+                   CusumDistributionDetector<>,
+                   FixedPointCusumDistributionDetector<>) {
+  constexpr std::size_t change = 20000;
+  constexpr std::size_t tolerance = 16;
+
+  std::mt19937 generator(42);
+  std::uniform_int_distribution<int> letters('a', 'z');
+  std::uniform_int_distribution<int> digits('0', '9');
+
+  TestType detector(params);
+  for (std::size_t i = 0;; ++i) {
+    REQUIRE(i < 2 * change);
+    const auto byte = i < change ? letters(generator) : digits(generator);
+    if (detector.step(byte)) {
+      REQUIRE(i >= change);
+      // The estimate must not precede the change, and must be much closer to
+      // the change than the step at which the change was detected.
+      const auto estimated_change = i + 1 - detector.change_point_lag();
+      REQUIRE(estimated_change + tolerance >= change);
+      REQUIRE((std::max(estimated_change, change) - change) * 2 < i - change);
+      break;
+    }
+  }
+}
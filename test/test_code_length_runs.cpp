@@ -0,0 +1,110 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+
+#include "code_length_runs.hpp"
+
+namespace {
+
+using SymbolBits = std::array<std::uint16_t, num_code_length_symbols>;
+
+// Decode runs back into the code lengths they send, as an inflater would,
+// requiring that each run is valid.
+auto decode(std::span<const CodeLengthRun> runs) -> std::vector<std::uint8_t> {
+  std::vector<std::uint8_t> code_lengths;
+  for (const auto run : runs) {
+    if (run.symbol < repeat_previous.symbol) {
+      REQUIRE(run.length == 1);
+      code_lengths.push_back(run.symbol);
+      continue;
+    }
+    const auto &repeat = run.symbol == repeat_previous.symbol ? repeat_previous
+                         : run.symbol == repeat_zero.symbol
+                             ? repeat_zero
+                             : repeat_zero_long;
+    REQUIRE(run.length >= repeat.min);
+    REQUIRE(run.length <= repeat.max);
+    REQUIRE(extra_bits(run) < (1U << repeat.num_extra_bits));
+    std::uint8_t length = 0;
+    if (run.symbol == repeat_previous.symbol) {
+      REQUIRE(!code_lengths.empty());
+      length = code_lengths.back();
+    }
+    code_lengths.insert(code_lengths.end(), run.length, length);
+  }
+  return code_lengths;
+}
+
+auto bits(std::span<const CodeLengthRun> runs, const SymbolBits &symbol_bits)
+    -> std::size_t {
+  std::size_t num_bits = 0;
+  for (const auto run : runs) {
+    num_bits += symbol_bits.at(run.symbol) + num_extra_bits(run.symbol);
+  }
+  return num_bits;
+}
+
+} // namespace
+
+TEST_CASE("code length runs") {
+  std::array<CodeLengthRun, maximum_num_code_lengths> runs{};
+
+  SECTION("optimal runs split a long run of zeros") {
+    SymbolBits symbol_bits{};
+    symbol_bits.fill(4);
+    const std::vector<std::uint8_t> code_lengths(140, 0);
+
+    const auto num_greedy_runs = greedy_code_length_runs(code_lengths, runs);
+    // 18 (138 zeros), 0, 0
+    REQUIRE(bits(std::span(runs.data(), num_greedy_runs), symbol_bits) == 19);
+
+    const auto num_optimal_runs =
+        optimal_code_length_runs(code_lengths, symbol_bits, runs);
+    // 18 (at least 134 zeros), then 16 to repeat the previous zero
+    REQUIRE(num_optimal_runs == 2);
+    REQUIRE(runs[1].symbol == repeat_previous.symbol);
+    REQUIRE(bits(std::span(runs.data(), num_optimal_runs), symbol_bits) ==
+            17);
+    REQUIRE(decode(std::span(runs.data(), num_optimal_runs)) == code_lengths);
+  }
+
+  SECTION("optimal runs are never larger than greedy runs") {
+    std::mt19937 rng(0);
+    for (int i = 0; i < 1000; ++i) {
+      // Mostly zeros, with runs of a few lengths, as in a header.
+      std::vector<std::uint8_t> code_lengths(
+          std::uniform_int_distribution<std::size_t>(
+              1, maximum_num_code_lengths)(rng));
+      std::uint8_t length = 0;
+      for (auto &code_length : code_lengths) {
+        if (rng() % 4 == 0) {
+          length = rng() % 2 == 0 ? 0 : rng() % 16;
+        }
+        code_length = length;
+      }
+      SymbolBits symbol_bits{};
+      for (auto &symbol_bit : symbol_bits) {
+        symbol_bit = 1 + (rng() % 7);
+      }
+      INFO(i);
+
+      const auto num_greedy_runs = greedy_code_length_runs(code_lengths, runs);
+      const std::vector greedy_runs(runs.begin(),
+                                    runs.begin() + num_greedy_runs);
+      REQUIRE(decode(greedy_runs) == code_lengths);
+
+      const auto num_optimal_runs =
+          optimal_code_length_runs(code_lengths, symbol_bits, runs);
+      const std::vector optimal_runs(runs.begin(),
+                                     runs.begin() + num_optimal_runs);
+      REQUIRE(decode(optimal_runs) == code_lengths);
+      REQUIRE(bits(optimal_runs, symbol_bits) <=
+              bits(greedy_runs, symbol_bits));
+    }
+  }
+}
@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <random>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+
+#include "code_lengths.hpp"
+#include "package_merge.hpp"
+
+namespace {
+
+constexpr std::size_t num_symbols = 288;
+constexpr std::uint8_t max_length = 15;
+constexpr std::uint8_t unlimited_length =
+    std::numeric_limits<std::uint8_t>::max();
+
+using Weights = std::array<std::size_t, num_symbols>;
+
+template <typename Lengths>
+auto cost(const Weights &weights, const Lengths &lengths) -> std::size_t {
+  std::size_t total = 0;
+  for (std::size_t i = 0; i < weights.size(); ++i) {
+    total += weights.at(i) * lengths.at(i);
+  }
+  return total;
+}
+
+template <typename Lengths> auto kraft_mcmillan(const Lengths &lengths) {
+  double km = 0;
+  for (auto length : lengths) {
+    if (length == 0) {
+      continue;
+    }
+    km += std::pow(2, -length);
+  }
+  return km;
+}
+
+// The cost of an unrestricted Huffman code, which is the sum of the weights
+// of the internal nodes.
+auto huffman_cost(const Weights &weights) -> std::size_t {
+  std::priority_queue<std::size_t, std::vector<std::size_t>, std::greater<>>
+      queue;
+  for (const auto weight : weights) {
+    if (weight != 0) {
+      queue.push(weight);
+    }
+  }
+  std::size_t total = 0;
+  while (queue.size() > 1) {
+    const auto first = queue.top();
+    queue.pop();
+    const auto second = queue.top();
+    queue.pop();
+    total += first + second;
+    queue.push(first + second);
+  }
+  return total;
+}
+
+auto random_weights(std::mt19937 &generator) -> Weights {
+  std::uniform_int_distribution<std::size_t> num_used(2, num_symbols);
+  std::geometric_distribution<std::size_t> weight(0.01);
+  Weights weights{};
+  const auto n = num_used(generator);
+  for (std::size_t i = 0; i < n; ++i) {
+    weights.at(i * num_symbols / n) = weight(generator) + 1;
+  }
+  return weights;
+}
+
+// Fibonacci weights give the deepest possible Huffman code.
+auto fibonacci_weights(std::size_t n) -> Weights {
+  Weights weights{};
+  std::size_t a = 1;
+  std::size_t b = 1;
+  for (std::size_t i = 0; i < n; ++i) {
+    weights.at(i) = a;
+    a = std::exchange(b, a + b);
+  }
+  return weights;
+}
+
+} // namespace
+
+TEST_CASE("code lengths") {
+  SECTION("are an optimal unrestricted code when within the maximum length") {
+    std::mt19937 generator(42);
+    for (auto i = 0; i < 200; ++i) {
+      auto weights = random_weights(generator);
+      const auto lengths =
+          code_lengths<num_symbols>(std::span(weights), unlimited_length);
+      REQUIRE(cost(weights, lengths) == huffman_cost(weights));
+      REQUIRE_THAT(kraft_mcmillan(lengths),
+                   Catch::Matchers::WithinAbs(1.0, 1e-6));
+    }
+  }
+
+  SECTION("are as short as package merge when length-limited") {
+    std::mt19937 generator(42);
+    for (auto i = 0; i < 200; ++i) {
+      auto weights = random_weights(generator);
+      const auto lengths =
+          code_lengths<num_symbols>(std::span(weights), max_length);
+      const auto package_merge_lengths =
+          package_merge<num_symbols>(std::span(weights), max_length);
+      REQUIRE(cost(weights, lengths) == cost(weights, package_merge_lengths));
+      REQUIRE(*std::ranges::max_element(lengths) <= max_length);
+    }
+  }
+
+  SECTION("fall back to package merge for very skewed weights") {
+    auto weights = fibonacci_weights(30);
+    const auto unrestricted_lengths =
+        code_lengths<num_symbols>(std::span(weights), unlimited_length);
+    REQUIRE(*std::ranges::max_element(unrestricted_lengths) == 29);
+    REQUIRE(cost(weights, unrestricted_lengths) == huffman_cost(weights));
+
+    const auto lengths =
+        code_lengths<num_symbols>(std::span(weights), max_length);
+    REQUIRE(*std::ranges::max_element(lengths) == max_length);
+    REQUIRE_THAT(kraft_mcmillan(lengths),
+                 Catch::Matchers::WithinAbs(1.0, 1e-6));
+    REQUIRE(cost(weights, lengths) ==
+            cost(weights,
+                 package_merge<num_symbols>(std::span(weights), max_length)));
+  }
+
+  SECTION("throws if inadequate max length") {
+    auto weights = fibonacci_weights(17);
+    REQUIRE_THROWS(code_lengths<num_symbols>(std::span(weights), 4));
+  }
+
+  SECTION("only one symbol") {
+    Weights weights{};
+    weights.at(7) = 5;
+    const auto lengths =
+        code_lengths<num_symbols>(std::span(weights), max_length);
+    REQUIRE(lengths.at(7) == 1);
+    REQUIRE(kraft_mcmillan(lengths) == 0.5);
+  }
+}
@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <span>
+#include <sstream>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+
+#include "compressor.hpp"
+#include "inflate.hpp"
+#include "options.hpp"
+
+namespace {
+
+auto read_input() -> std::vector<std::uint8_t> {
+  std::ifstream file(std::filesystem::path(CGZIP_DATA_DIR) / "calgary_corpus" /
+                         "paper1",
+                     std::ios::binary);
+  return {std::istreambuf_iterator<char>(file),
+          std::istreambuf_iterator<char>()};
+}
+
+} // namespace
+
+TEST_CASE("compressor skips change point detection for tiny inputs") {
+  const Options options;
+  const auto warmup =
+      static_cast<std::size_t>(options.change_point_detector_params.warmup);
+  std::ostringstream out;
+  Compressor compressor(out, options);
+  REQUIRE(compressor.is_change_point_detection());
+
+  SECTION("when the input size is below the warmup") {
+    compressor.set_input_size(warmup - 1);
+    REQUIRE_FALSE(compressor.is_change_point_detection());
+  }
+
+  SECTION("but not when the input size reaches the warmup") {
+    compressor.set_input_size(warmup);
+    REQUIRE(compressor.is_change_point_detection());
+  }
+
+  SECTION("when compressing a tiny input whole") {
+    const auto input = read_input();
+    compressor.compress(std::span(input).first(warmup - 1));
+    REQUIRE_FALSE(compressor.is_change_point_detection());
+  }
+}
+
+TEST_CASE("compressor writes the same output for a tiny input however it is "
+          "put") {
+  const auto input = read_input();
+  const auto bytes = std::span(input).first(1024);
+  const Options options;
+
+  std::ostringstream compressed_whole;
+  Compressor(compressed_whole, options).compress(bytes);
+
+  std::ostringstream streamed;
+  Compressor compressor(streamed, options);
+  compressor.set_input_size(bytes.size());
+  for (const auto byte : bytes) {
+    compressor.put(byte);
+  }
+  compressor.finish();
+
+  REQUIRE(streamed.str() == compressed_whole.str());
+}
+
+TEST_CASE("compressor flushes") {
+  const auto input = read_input();
+  // The second half repeats the first, so that back references across the
+  // flush would be found if they were allowed.
+  const auto first = std::span(input).first(1U << 14U);
+  std::vector<std::uint8_t> bytes(2 * first.size());
+  std::ranges::copy(first, bytes.begin());
+  std::ranges::copy(first, bytes.begin() + first.size());
+  const Options options;
+  std::ostringstream out;
+  Compressor compressor(out, options);
+
+  SECTION("sync flush writes all of the bytes put so far") {
+    for (const auto byte : first) {
+      compressor.put(byte);
+    }
+    compressor.flush(Flush::sync);
+    const auto decompressed = inflate_with_zlib(out.str(), true);
+    REQUIRE(decompressed.has_value());
+    REQUIRE(*decompressed == std::vector(first.begin(), first.end()));
+  }
+
+  SECTION("full flush forgets the bytes before it") {
+    for (const auto flush : {Flush::sync, Flush::full}) {
+      out.str("");
+      Compressor flushed_compressor(out, options);
+      for (const auto byte : first) {
+        flushed_compressor.put(byte);
+      }
+      flushed_compressor.flush(flush);
+      const auto flush_point = out.str().size();
+      for (const auto byte : first) {
+        flushed_compressor.put(byte);
+      }
+      flushed_compressor.finish();
+
+      // Decoding starts from the flush without the bytes before it, so it
+      // fails on any back reference that crosses the flush.
+      const auto decompressed =
+          inflate_with_zlib(out.str().substr(flush_point), false);
+      if (flush == Flush::full) {
+        REQUIRE(decompressed.has_value());
+        REQUIRE(*decompressed == std::vector(first.begin(), first.end()));
+      } else {
+        REQUIRE_FALSE(decompressed.has_value());
+      }
+      REQUIRE(inflate_with_zlib(out.str(), true) == bytes);
+    }
+  }
+
+  SECTION("without flushing, flush options leave the output unchanged") {
+    for (const auto byte : bytes) {
+      compressor.put(byte);
+    }
+    compressor.finish();
+
+    Options flush_options;
+    flush_options.flush = Flush::full;
+    flush_options.flush_bytes = 1U << 12U;
+    flush_options.flush_ms = 1;
+    std::ostringstream flush_options_out;
+    Compressor flush_options_compressor(flush_options_out, flush_options);
+    for (const auto byte : bytes) {
+      flush_options_compressor.put(byte);
+    }
+    flush_options_compressor.finish();
+
+    REQUIRE(flush_options_out.str() == out.str());
+    REQUIRE(inflate_with_zlib(out.str(), true) == bytes);
+  }
+}
@@ -0,0 +1,58 @@
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string_view>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+
+#include "content_type.hpp"
+
+namespace {
+
+// Read the sample of a data file from which its content type is sniffed.
+auto read_sample(const std::filesystem::path &path)
+    -> std::vector<std::uint8_t> {
+  std::ifstream file(std::filesystem::path(CGZIP_DATA_DIR) / path,
+                     std::ios::binary);
+  std::vector<std::uint8_t> bytes{std::istreambuf_iterator<char>(file),
+                                  std::istreambuf_iterator<char>()};
+  bytes.resize(std::min(bytes.size(), content_type_sample_size));
+  return bytes;
+}
+
+} // namespace
+
+TEST_CASE("content type") {
+  SECTION("sniffs text") {
+    for (const std::string_view path :
+         {"calgary_corpus/book1", "calgary_corpus/progc",
+          "canterbury_corpus/alice29.txt", "millbay_corpus/jquery-3.6.4.js",
+          "millbay_corpus/compressed-file-svgrepo-com.svg",
+          "other/abc.txt"}) {
+      INFO(path);
+      REQUIRE(sniff_content_type(read_sample(path)) == ContentType::text);
+    }
+  }
+
+  SECTION("sniffs DNA, despite the header line of FASTA") {
+    REQUIRE(sniff_content_type(read_sample(
+                "millbay_corpus/GCA_009858895.3.fasta")) == ContentType::dna);
+  }
+
+  SECTION("sniffs binary") {
+    for (const std::string_view path :
+         {"calgary_corpus/pic", "calgary_corpus/geo", "calgary_corpus/obj1",
+          "canterbury_corpus/kennedy.xls", "millbay_corpus/pear.jpg",
+          "millbay_corpus/pg1513.epub"}) {
+      INFO(path);
+      REQUIRE(sniff_content_type(read_sample(path)) == ContentType::binary);
+    }
+  }
+
+  SECTION("sniffs an empty sample as text") {
+    REQUIRE(sniff_content_type({}) == ContentType::text);
+  }
+}
@@ -0,0 +1,43 @@
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+#include <catch2/catch_all.hpp>
+
+#include "crc32.hpp"
+
+namespace {
+
+constexpr std::string_view check_input = "123456789";
+
+// The standard check value of CRC-32, i.e. the CRC-32 of check_input.
+constexpr std::uint32_t check_value = 0xCBF43926U;
+
+constexpr auto check_bytes() -> std::array<std::uint8_t, check_input.size()> {
+  std::array<std::uint8_t, check_input.size()> bytes{};
+  for (std::size_t i = 0; i < bytes.size(); ++i) {
+    bytes.at(i) = static_cast<std::uint8_t>(check_input[i]);
+  }
+  return bytes;
+}
+
+} // namespace
+
+TEST_CASE("crc32") {
+  constexpr auto bytes = check_bytes();
+
+  SECTION("matches the check value") {
+    STATIC_REQUIRE(crc32(0, bytes) == check_value);
+  }
+
+  SECTION("is 0 for no bytes") { REQUIRE(crc32(0, {}) == 0); }
+
+  SECTION("can be computed incrementally") {
+    std::uint32_t crc = 0;
+    for (const auto byte : bytes) {
+      crc = crc32(crc, std::span(&byte, 1));
+    }
+    REQUIRE(crc == check_value);
+  }
+}
@@ -0,0 +1,79 @@
+#include <array>
+#include <cstddef>
+
+#include <catch2/catch_all.hpp>
+
+#include "effort_controller.hpp"
+
+namespace {
+
+// The throughput of each effort, in bytes per second, of a simulated input.
+constexpr std::array<double, efforts.size()> bytes_per_second_by_level{
+    100e6, 30e6, 10e6, 8e6, 6e6, 4e6};
+
+auto level(const EffortController &controller) -> std::size_t {
+  return static_cast<std::size_t>(&controller.effort() - efforts.data());
+}
+
+// Step the controller through num_intervals of the simulated input, and
+// return the seconds taken.
+auto simulate(EffortController &controller, std::size_t num_intervals,
+              double speedup = 1.0) -> double {
+  double seconds = 0.0;
+  for (std::size_t i = 0; i < num_intervals; ++i) {
+    const auto interval_seconds =
+        static_cast<double>(effort_interval) /
+        (bytes_per_second_by_level.at(level(controller)) * speedup);
+    seconds += interval_seconds;
+    controller.step(effort_interval, interval_seconds);
+  }
+  return seconds;
+}
+
+} // namespace
+
+TEST_CASE("effort controller") {
+  SECTION("starts with the most effort, and keeps it when it meets the "
+          "target") {
+    EffortController controller(2e6);
+    REQUIRE(level(controller) == efforts.size() - 1);
+    simulate(controller, 100);
+    REQUIRE(level(controller) == efforts.size() - 1);
+  }
+
+  SECTION("lowers the effort one level per interval while behind") {
+    EffortController controller(1e9);
+    for (auto expected = efforts.size() - 1; expected-- > 0;) {
+      REQUIRE(controller.step(effort_interval, 1.0));
+      REQUIRE(level(controller) == expected);
+    }
+    REQUIRE(controller.effort().coding == Coding::stored);
+    REQUIRE_FALSE(controller.step(effort_interval, 1.0));
+  }
+
+  SECTION("averages the target between the levels on either side of it") {
+    constexpr std::size_t num_intervals = 1000;
+    constexpr double target = 7e6;
+    EffortController controller(target);
+    const auto seconds = simulate(controller, num_intervals);
+    const auto bytes_per_second =
+        static_cast<double>(num_intervals * effort_interval) / seconds;
+    REQUIRE(bytes_per_second >= target * 0.99);
+    REQUIRE(bytes_per_second <= target * 1.05);
+    REQUIRE(level(controller) >= 3);
+    REQUIRE(level(controller) <= 4);
+  }
+
+  SECTION("banks a bounded amount of time saved on easy input") {
+    EffortController controller(5e6);
+    // Easy input, on which even the most effort is far ahead of the target.
+    simulate(controller, 1000, 10.0);
+    REQUIRE(level(controller) == efforts.size() - 1);
+    // Hard input, on which the most effort falls behind by a quarter of an
+    // interval each interval.
+    simulate(controller, (maximum_banked_effort_intervals * 4) - 1);
+    REQUIRE(level(controller) == efforts.size() - 1);
+    simulate(controller, 2);
+    REQUIRE(level(controller) < efforts.size() - 1);
+  }
+}
@@ -0,0 +1,46 @@
+#include <cstddef>
+#include <cstdint>
+#include <random>
+
+#include <catch2/catch_all.hpp>
+
+#include "entropy_sampler.hpp"
+
+TEST_CASE("entropy sampler") {
+  SECTION("completes a sample every sample size bytes") {
+    EntropySampler<16> sampler;
+    for (std::size_t i = 1; i <= 64; ++i) {
+      const auto is_sample_complete = sampler.step(0);
+      REQUIRE(is_sample_complete == (i % 16 == 0));
+    }
+  }
+
+  SECTION("measures the entropy of each sample on its own") {
+    EntropySampler<256> sampler;
+    for (std::size_t i = 0; i < 256; ++i) {
+      sampler.step(static_cast<std::uint8_t>(i));
+    }
+    REQUIRE_THAT(sampler.entropy(), Catch::Matchers::WithinAbs(8.0, 1e-9));
+
+    for (std::size_t i = 0; i < 256; ++i) {
+      sampler.step(0);
+    }
+    REQUIRE_THAT(sampler.entropy(), Catch::Matchers::WithinAbs(0.0, 1e-9));
+
+    for (std::size_t i = 0; i < 256; ++i) {
+      sampler.step(i % 4 == 0 ? 'a' : 'b');
+    }
+    // 1/4 log2(4) + 3/4 log2(4/3)
+    REQUIRE_THAT(sampler.entropy(),
+                 Catch::Matchers::WithinAbs(0.811278124459, 1e-9));
+  }
+
+  SECTION("measures random bytes close to 8 bits per byte") {
+    EntropySampler<> sampler;
+    std::mt19937 generator(0);
+    while (!sampler.step(static_cast<std::uint8_t>(generator()))) {
+    }
+    REQUIRE(sampler.entropy() > 7.9);
+    REQUIRE(sampler.entropy() < 8.0);
+  }
+}
@@ -0,0 +1,93 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+
+#include "histogram.hpp"
+
+constexpr std::size_t num_byte_symbols = 256;
+
+template <std::size_t N>
+auto naive_counts(const std::vector<std::uint8_t> &symbols)
+    -> std::array<std::uint32_t, N> {
+  std::array<std::uint32_t, N> counts{};
+  for (const auto symbol : symbols) {
+    counts.at(symbol)++;
+  }
+  return counts;
+}
+
+auto random_bytes(std::size_t size) -> std::vector<std::uint8_t> {
+  std::mt19937 generator(42);
+  std::uniform_int_distribution<int> distribution(0, 255);
+  std::vector<std::uint8_t> bytes(size);
+  for (auto &byte : bytes) {
+    byte = static_cast<std::uint8_t>(distribution(generator));
+  }
+  return bytes;
+}
+
+TEST_CASE("histogram") {
+  Histogram<num_byte_symbols> histogram;
+
+  SECTION("starts empty") {
+    const auto counts = histogram.counts();
+    for (const auto count : counts) {
+      REQUIRE(count == 0);
+    }
+  }
+
+  SECTION("counts single symbols") {
+    const auto bytes = random_bytes(1000);
+    for (const auto byte : bytes) {
+      histogram.add(byte);
+    }
+    REQUIRE(histogram.counts() == naive_counts<num_byte_symbols>(bytes));
+  }
+
+  SECTION("counts runs of the same symbol") {
+    const std::vector<std::uint8_t> bytes(65536, 'a');
+    for (const auto byte : bytes) {
+      histogram.add(byte);
+    }
+    REQUIRE(histogram.counts().at('a') == 65536);
+  }
+
+  SECTION("counts spans of bytes, including unaligned tails") {
+    for (const auto size : {0, 1, 7, 8, 31, 32, 33, 1000}) {
+      histogram.reset();
+      const auto bytes = random_bytes(size);
+      histogram.add(std::span<const std::uint8_t>(bytes));
+      REQUIRE(histogram.counts() == naive_counts<num_byte_symbols>(bytes));
+    }
+  }
+
+  SECTION("mixes single symbols and spans") {
+    const auto bytes = random_bytes(100);
+    histogram.add(bytes.front());
+    histogram.add(std::span<const std::uint8_t>(bytes).subspan(1));
+    REQUIRE(histogram.counts() == naive_counts<num_byte_symbols>(bytes));
+  }
+
+  SECTION("reset clears all count tables") {
+    const auto bytes = random_bytes(100);
+    histogram.add(std::span<const std::uint8_t>(bytes));
+    histogram.reset();
+    const auto counts = histogram.counts();
+    for (const auto count : counts) {
+      REQUIRE(count == 0);
+    }
+  }
+
+  SECTION("supports alphabets that are not a multiple of the vector width") {
+    Histogram<19> small_histogram;
+    const std::vector<std::uint8_t> symbols = {0, 18, 18, 3, 17, 18, 0};
+    for (const auto symbol : symbols) {
+      small_histogram.add(symbol);
+    }
+    REQUIRE(small_histogram.counts() == naive_counts<19>(symbols));
+  }
+}
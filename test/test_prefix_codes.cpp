@@ -42,3 +42,20 @@ TEST_CASE("prefix codes") {
             static_cast<std::uint16_t>(0b11000000 + (i - 280)));
   }
 }
+
+TEST_CASE("code words") {
+  SECTION("reverse the bits of prefix codes") {
+    constexpr auto code_word = CodeWord::from_prefix_code(
+        PrefixCode{.bits = 0b110010000, .length = 9});
+    REQUIRE(code_word.bits == 0b000010011);
+    REQUIRE(code_word.length == 9);
+  }
+
+  SECTION("place offsets after the prefix code") {
+    constexpr auto code_word =
+        CodeWord::from_prefix_code(PrefixCode{.bits = 0b0001, .length = 4})
+            .with_offset(Offset{.bits = 0b101, .num_bits = 3});
+    REQUIRE(code_word.bits == 0b101'1000);
+    REQUIRE(code_word.length == 7);
+  }
+}
@@ -0,0 +1,114 @@
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+
+#include <catch2/catch_all.hpp>
+
+#include "lzss.hpp"
+#include "tokenizers.hpp"
+
+namespace {
+
+// Tokenize bytes as a block stream does, describing each literal by its byte
+// and each back reference as (distance,length).
+template <typename Tokenizer>
+auto tokenize(Tokenizer &tokenizer, std::string_view bytes) -> std::string {
+  std::string tokens;
+  const auto step = [&tokenizer, &tokens] {
+    const auto back_reference = tokenizer.back_reference();
+    if (back_reference.length >= minimum_back_reference_length) {
+      tokens += "(" + std::to_string(back_reference.distance) + "," +
+                std::to_string(back_reference.length) + ")";
+      tokenizer.take_back_reference();
+      return;
+    }
+    tokens += static_cast<char>(tokenizer.literal());
+    tokenizer.take_literal();
+  };
+  for (const auto byte : bytes) {
+    tokenizer.put(static_cast<std::uint8_t>(byte));
+    if (tokenizer.is_full()) {
+      step();
+    }
+  }
+  while (!tokenizer.is_empty()) {
+    step();
+  }
+  return tokens;
+}
+
+} // namespace
+
+TEST_CASE("literal tokenizer") {
+  LiteralTokenizer tokenizer;
+  REQUIRE(tokenize(tokenizer, "abbbbbbc") == "abbbbbbc");
+}
+
+TEST_CASE("run length tokenizer") {
+  constexpr std::size_t look_ahead_size = 8;
+  RunLengthTokenizer<look_ahead_size> tokenizer;
+
+  SECTION("runs become back references with a distance of one") {
+    REQUIRE(tokenize(tokenizer, "abbbbbbcdd") == "ab(1,5)cdd");
+  }
+
+  SECTION("runs are only as long as the look-ahead") {
+    REQUIRE(tokenize(tokenizer, std::string(20, 'a')) == "a(1,8)(1,8)(1,3)");
+  }
+
+  SECTION("runs do not continue across a cleared look-back") {
+    REQUIRE(tokenize(tokenizer, "aa") == "aa");
+    tokenizer.clear_look_back();
+    REQUIRE(tokenize(tokenizer, "aaaa") == "a(1,3)");
+  }
+}
+
+TEST_CASE("lzss takes runs without walking their chain") {
+  constexpr std::size_t look_back_size = 64;
+  constexpr std::size_t look_ahead_size = 8;
+  Lzss<look_back_size, look_ahead_size> tokenizer;
+
+  SECTION("runs of a byte") {
+    REQUIRE(tokenize(tokenizer, std::string(20, 'a')) == "a(1,8)(1,8)(1,3)");
+  }
+
+  SECTION("runs of a short period") {
+    std::string bytes = "x";
+    for (int i = 0; i < 7; ++i) {
+      bytes += "abc";
+    }
+    REQUIRE(tokenize(tokenizer, bytes) == "xabc(3,8)(3,8)bc");
+  }
+
+  SECTION("runs longer than the look-back buffer") {
+    std::string tokens = "a";
+    for (int i = 0; i < 124; ++i) {
+      tokens += "(1,8)";
+    }
+    tokens += "(1,7)";
+    REQUIRE(tokenize(tokenizer, std::string(1000, 'a')) == tokens);
+  }
+}
+
+TEST_CASE("lzss bounds the chain visits of its searches") {
+  // Random bytes over two letters make every chain long, and most of the
+  // occurrences in it match for a few bytes.
+  std::mt19937 generator(0);
+  std::string bytes(1U << 18U, 'a');
+  for (auto &byte : bytes) {
+    if (generator() % 2 == 0) {
+      byte = 'b';
+    }
+  }
+  Lzss<> tokenizer;
+  static_cast<void>(tokenize(tokenizer, bytes));
+
+  const auto &counters = tokenizer.counters();
+  REQUIRE(counters.num_truncated_searches > 0);
+  REQUIRE(counters.num_throttled_searches > 0);
+  REQUIRE(counters.num_chain_visits <=
+          maximum_chain_visit_credit + (chain_visits_per_byte * bytes.size()) +
+              maximum_chain_visits);
+}
@@ -0,0 +1,32 @@
+#include <cstdint>
+
+#include <catch2/catch_all.hpp>
+
+#include "types.hpp"
+
+TEST_CASE("symbols with offsets") {
+  SECTION("distances map to the symbol and offset of their range") {
+    for (const auto &range : detail::distance_ranges) {
+      for (std::uint32_t distance = range.start; distance <= range.end;
+           ++distance) {
+        const auto symbol_with_offset =
+            SymbolWithOffset::from_distance(distance);
+        REQUIRE(symbol_with_offset.symbol == range.symbol);
+        REQUIRE(symbol_with_offset.offset.bits == distance - range.start);
+        REQUIRE(symbol_with_offset.offset.num_bits == range.num_offset_bits);
+      }
+    }
+  }
+
+  SECTION("lengths map to the symbol and offset of their range") {
+    for (const auto &range : detail::length_ranges) {
+      for (std::uint16_t length = range.start; length <= range.end; ++length) {
+        const auto &symbol_with_offset = SymbolWithOffset::from_length(length);
+        REQUIRE(symbol_with_offset.symbol == range.symbol);
+        REQUIRE(symbol_with_offset.offset.bits == length - range.start);
+        REQUIRE(symbol_with_offset.offset.num_bits == range.num_offset_bits);
+        REQUIRE(SymbolWithOffset::to_length(symbol_with_offset) == length);
+      }
+    }
+  }
+}